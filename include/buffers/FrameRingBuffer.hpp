@@ -0,0 +1,215 @@
+/**
+ * @file One buffer, mapped for the whole run, that each frame's dynamic data is bump-allocated from.
+ *
+ * The buffer is split into three regions and a frame writes only to its own, so the CPU fills one region while the
+ * GPU may still be reading the two before it:
+ *
+ *   region 0 | region 1 | region 2
+ *
+ * A fence placed after each frame's draws guards its region; the frame that comes back round to it waits on that
+ * fence, which has almost always signalled by then. Uniform blocks, instance attributes and indirect commands are
+ * written through the returned pointers and read by GL at the returned offsets, with no `glBufferData` orphaning or
+ * `glBufferSubData` copy in between.
+ *
+ * Without `glBufferStorage` the same interface is kept over a CPU copy of the region, uploaded by `Commit`.
+ */
+
+#ifndef BUFFERS_FRAME_RING_BUFFER_H
+#define BUFFERS_FRAME_RING_BUFFER_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "openGLExtensions.hpp"
+#include "render/StateCache.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Buffers {
+// Frames in flight: one being written, up to two being read
+constexpr size_t FRAME_RING_REGIONS = 3;
+constexpr size_t DEFAULT_FRAME_RING_BYTES = 1 << 20;
+// Generous enough for any uniform buffer offset alignment drivers report
+constexpr size_t FRAME_RING_REGION_ALIGNMENT = 256;
+// How long one wait on a fence lasts before it is retried
+constexpr GLuint64 FRAME_FENCE_TIMEOUT_NANOSECONDS = 1000000;
+
+/**
+ * Part of the current frame's region. `Pointer` is null when the region had no room left.
+ */
+struct RingAllocation {
+    GLuint Buffer = 0;
+    // Bytes from the start of `Buffer`, for binding ranges and as attribute or indirect offsets
+    size_t Offset = 0;
+    void *Pointer = nullptr;
+};
+
+struct RingStatistics {
+    // Frames that found their region still in use and had to wait for the GPU
+    size_t Waits = 0;
+    // Allocations refused because the region was full
+    size_t Overflows = 0;
+    // Most bytes a single frame used
+    size_t PeakBytes = 0;
+};
+
+/**
+ * Each frame calls `Begin`, allocates and writes, calls `Commit` before the draws that read the data, and calls `End`
+ * once they are issued.
+ */
+class FrameRingBuffer {
+private:
+    GLuint _buffer = 0;
+    size_t _regionBytes = 0;
+    bool _persistent = false;
+    // The persistent mapping of the whole buffer, or the CPU copy of one region without it
+    unsigned char *_mapped = nullptr;
+    std::vector<unsigned char> _staging;
+    std::array<GLsync, FRAME_RING_REGIONS> _fences = {};
+    size_t _region = 0;
+    size_t _used = 0;
+    size_t _committed = 0;
+    RingStatistics _statistics;
+
+    static size_t alignUp(size_t value, size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+    size_t regionStart() const { return _region * _regionBytes; }
+
+    // Blocks until the GPU is done with the draws that last read `region`
+    void waitForRegion(size_t region) {
+        GLsync &fence = _fences[region];
+
+        if (!fence) {
+            return;
+        }
+
+        GLenum status = glClientWaitSync(fence, 0, 0);
+
+        if (status == GL_TIMEOUT_EXPIRED) {
+            ++_statistics.Waits;
+
+            do {
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FRAME_FENCE_TIMEOUT_NANOSECONDS);
+            } while (status == GL_TIMEOUT_EXPIRED);
+        }
+
+        if (status == GL_WAIT_FAILED) {
+            std::cout << "ERROR::FRAME_RING_BUFFER::WAIT_FAILED" << std::endl;
+        }
+
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+public:
+    explicit FrameRingBuffer(size_t regionBytes = DEFAULT_FRAME_RING_BYTES) :
+        _regionBytes(alignUp(regionBytes, FRAME_RING_REGION_ALIGNMENT)),
+        _persistent(Extensions::BufferStorageSupported) {
+        const size_t bytes = _regionBytes * FRAME_RING_REGIONS;
+
+        Render::StateCache &state = Render::StateCache::Shared();
+        glGenBuffers(1, &_buffer);
+        state.BindBuffer(GL_COPY_WRITE_BUFFER, _buffer);
+
+        if (_persistent) {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            Extensions::BufferStorage(GL_COPY_WRITE_BUFFER, bytes, nullptr, flags);
+            _mapped = static_cast<unsigned char *>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, bytes, flags));
+
+            if (!_mapped) {
+                std::cout << "ERROR::FRAME_RING_BUFFER::MAP_FAILED" << std::endl;
+            }
+        } else {
+            glBufferData(GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+            _staging.resize(_regionBytes);
+        }
+    }
+
+    FrameRingBuffer(const FrameRingBuffer &) = delete;
+    FrameRingBuffer &operator=(const FrameRingBuffer &) = delete;
+
+    ~FrameRingBuffer() {
+        for (GLsync &fence : _fences) {
+            if (fence) {
+                glDeleteSync(fence);
+            }
+        }
+
+        Render::StateCache &state = Render::StateCache::Shared();
+
+        if (_mapped) {
+            state.BindBuffer(GL_COPY_WRITE_BUFFER, _buffer);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        }
+
+        state.ForgetBuffer(_buffer);
+        glDeleteBuffers(1, &_buffer);
+    }
+
+    GLuint Buffer() const { return _buffer; }
+
+    // Whether writes land in GL memory directly rather than through `Commit`'s upload
+    bool IsPersistent() const { return _persistent; }
+
+    // Moves on to the next region, waiting for the GPU if it is still reading it
+    void Begin() {
+        _region = (_region + 1) % FRAME_RING_REGIONS;
+        _used = 0;
+        _committed = 0;
+        waitForRegion(_region);
+    }
+
+    /**
+     * Takes `bytes` from the current region at an offset, counted from the start of the buffer, that is a multiple
+     * of `alignment`. The memory is only valid until the frame's `End`.
+     */
+    RingAllocation Allocate(size_t bytes, size_t alignment = 16) {
+        const size_t start = regionStart();
+        const size_t offset = alignUp(start + _used, alignment) - start;
+
+        if (offset + bytes > _regionBytes || (_persistent && !_mapped)) {
+            ++_statistics.Overflows;
+            return {_buffer, 0, nullptr};
+        }
+
+        _used = offset + bytes;
+        _statistics.PeakBytes = std::max(_statistics.PeakBytes, _used);
+
+        unsigned char *pointer = _persistent ? _mapped + start + offset : _staging.data() + offset;
+        return {_buffer, start + offset, pointer};
+    }
+
+    /**
+     * Makes what was written so far visible to GL. The mapping is coherent, so this only uploads without
+     * `glBufferStorage`; it can be called more than once a frame, and sends only what is new each time.
+     */
+    void Commit() {
+        if (!_persistent && _used > _committed) {
+            Render::StateCache::Shared().BindBuffer(GL_COPY_WRITE_BUFFER, _buffer);
+            glBufferSubData(
+                GL_COPY_WRITE_BUFFER, regionStart() + _committed, _used - _committed, _staging.data() + _committed
+            );
+        }
+
+        _committed = _used;
+    }
+
+    // Fences the region once every draw reading it has been issued
+    void End() {
+        if (_fences[_region]) {
+            glDeleteSync(_fences[_region]);
+        }
+
+        _fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // Counts since the buffer was created
+    const RingStatistics &Statistics() const { return _statistics; }
+};
+} // namespace Buffers
+
+#endif
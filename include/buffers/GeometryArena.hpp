@@ -0,0 +1,264 @@
+/**
+ * @file One vertex buffer, one index buffer and one vertex array shared by every mesh of a vertex format.
+ *
+ * Meshes sub-allocate a vertex range and an index range and draw with `glDrawElementsBaseVertex`, so consecutive
+ * meshes never switch vertex arrays or buffers. Freed ranges go back to a free list and are reused by later loads.
+ * When a buffer runs out of space it is reallocated at double the size and its contents copied on the GPU.
+ */
+
+#ifndef BUFFERS_GEOMETRY_ARENA_H
+#define BUFFERS_GEOMETRY_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <utility>
+
+#include "buffers/RangeAllocator.hpp"
+#include "buffers/VertexFormat.hpp"
+#include "render/StateCache.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Buffers {
+constexpr size_t DEFAULT_ARENA_VERTICES = 1 << 16;
+constexpr size_t DEFAULT_ARENA_INDEX_BYTES = 1 << 20;
+// Keeps every index range aligned for both 16 and 32-bit indices
+constexpr size_t ARENA_INDEX_ALIGNMENT = 4;
+
+class GeometryArena;
+
+/**
+ * A mesh's ranges in an arena, returned to it on destruction. Move-only.
+ */
+class GeometryAllocation {
+private:
+    friend class GeometryArena;
+
+    GeometryArena *_arena = nullptr;
+    size_t _firstVertex = 0;
+    size_t _vertexCount = 0;
+    size_t _indexOffset = 0;
+    size_t _indexBytes = 0;
+
+public:
+    GeometryAllocation() = default;
+    GeometryAllocation(const GeometryAllocation &) = delete;
+    GeometryAllocation &operator=(const GeometryAllocation &) = delete;
+
+    GeometryAllocation(GeometryAllocation &&other) noexcept { *this = std::move(other); }
+
+    GeometryAllocation &operator=(GeometryAllocation &&other) noexcept;
+
+    ~GeometryAllocation();
+
+    bool IsValid() const { return _arena != nullptr; }
+
+    GeometryArena *Arena() const { return _arena; }
+
+    // Added to every index by the base-vertex draw calls
+    GLint BaseVertex() const { return static_cast<GLint>(_firstVertex); }
+
+    size_t VertexCount() const { return _vertexCount; }
+
+    // Byte offset of the first index in the arena's index buffer
+    size_t IndexOffset() const { return _indexOffset; }
+
+    size_t IndexBytes() const { return _indexBytes; }
+};
+
+class GeometryArena {
+private:
+    VertexFormat _format;
+    GLuint _vertexArray = 0;
+    GLuint _vertexBuffer = 0;
+    GLuint _indexBuffer = 0;
+    RangeAllocator _vertices;
+    RangeAllocator _indices;
+
+    static GLuint ResizeBuffer(GLuint buffer, size_t oldSize, size_t newSize) {
+        Render::StateCache &state = Render::StateCache::Shared();
+        GLuint resized;
+        glGenBuffers(1, &resized);
+        state.BindBuffer(GL_COPY_WRITE_BUFFER, resized);
+        glBufferData(GL_COPY_WRITE_BUFFER, newSize, nullptr, GL_STATIC_DRAW);
+
+        if (buffer) {
+            state.BindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+            state.ForgetBuffer(buffer);
+            glDeleteBuffers(1, &buffer);
+        }
+
+        return resized;
+    }
+
+    void Resize(size_t vertexCapacity, size_t indexCapacity) {
+        const size_t stride = VertexStride(_format);
+
+        if (!_vertexArray) {
+            glGenVertexArrays(1, &_vertexArray);
+        }
+
+        if (vertexCapacity > _vertices.Capacity()) {
+            _vertexBuffer = ResizeBuffer(_vertexBuffer, _vertices.Capacity() * stride, vertexCapacity * stride);
+            _vertices.Grow(vertexCapacity);
+        }
+
+        if (indexCapacity > _indices.Capacity()) {
+            _indexBuffer = ResizeBuffer(_indexBuffer, _indices.Capacity(), indexCapacity);
+            _indices.Grow(indexCapacity);
+        }
+
+        // The vertex array holds on to buffer names, so point it at the new ones
+        Render::StateCache &state = Render::StateCache::Shared();
+        state.BindVertexArray(_vertexArray);
+        state.BindBuffer(GL_ARRAY_BUFFER, _vertexBuffer);
+        BindVertexAttributes(_format);
+        state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer);
+    }
+
+    static size_t GrownCapacity(size_t capacity, size_t minimum, size_t required) {
+        return std::max({capacity * 2, minimum, capacity + required});
+    }
+
+public:
+    explicit GeometryArena(VertexFormat format) : _format(format) {}
+
+    GeometryArena(const GeometryArena &) = delete;
+    GeometryArena &operator=(const GeometryArena &) = delete;
+
+    /**
+     * The arena used by all models for `format`. Like `Textures::TextureCache::Shared`, it never touches GL on
+     * destruction; call `Release` while the context is still current to free its buffers.
+     */
+    static GeometryArena &Shared(VertexFormat format) {
+        static GeometryArena full(VertexFormat::Full);
+        static GeometryArena packed(VertexFormat::Packed);
+        return format == VertexFormat::Packed ? packed : full;
+    }
+
+    /**
+     * Grows the buffers once up front so a model's meshes can be allocated without repeated reallocation.
+     */
+    void Reserve(size_t vertexCount, size_t indexBytes) {
+        const size_t vertexCapacity = _vertices.Used() + vertexCount;
+        const size_t indexCapacity = _indices.Used() + indexBytes + ARENA_INDEX_ALIGNMENT;
+
+        if (vertexCapacity > _vertices.Capacity() || indexCapacity > _indices.Capacity()) {
+            Resize(std::max(vertexCapacity, _vertices.Capacity()), std::max(indexCapacity, _indices.Capacity()));
+        }
+    }
+
+    /**
+     * Copies `vertexCount` vertices in this arena's format and `indexBytes` bytes of indices into free ranges.
+     */
+    GeometryAllocation Allocate(const void *vertices, size_t vertexCount, const void *indices, size_t indexBytes) {
+        const size_t stride = VertexStride(_format);
+
+        if (!_vertexArray) {
+            Resize(std::max(DEFAULT_ARENA_VERTICES, vertexCount), std::max(DEFAULT_ARENA_INDEX_BYTES, indexBytes));
+        }
+
+        size_t firstVertex = _vertices.Allocate(vertexCount);
+
+        if (firstVertex == RangeAllocator::INVALID_OFFSET) {
+            Resize(GrownCapacity(_vertices.Capacity(), DEFAULT_ARENA_VERTICES, vertexCount), _indices.Capacity());
+            firstVertex = _vertices.Allocate(vertexCount);
+        }
+
+        size_t indexOffset = _indices.Allocate(indexBytes, ARENA_INDEX_ALIGNMENT);
+
+        if (indexOffset == RangeAllocator::INVALID_OFFSET) {
+            Resize(
+                _vertices.Capacity(),
+                GrownCapacity(_indices.Capacity(), DEFAULT_ARENA_INDEX_BYTES, indexBytes + ARENA_INDEX_ALIGNMENT)
+            );
+            indexOffset = _indices.Allocate(indexBytes, ARENA_INDEX_ALIGNMENT);
+        }
+
+        // Upload through the copy targets, which leaves the bound vertex array's state alone
+        Render::StateCache &state = Render::StateCache::Shared();
+        state.BindBuffer(GL_COPY_WRITE_BUFFER, _vertexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, firstVertex * stride, vertexCount * stride, vertices);
+        state.BindBuffer(GL_COPY_WRITE_BUFFER, _indexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, indexBytes, indices);
+
+        GeometryAllocation allocation;
+        allocation._arena = this;
+        allocation._firstVertex = firstVertex;
+        allocation._vertexCount = vertexCount;
+        allocation._indexOffset = indexOffset;
+        allocation._indexBytes = indexBytes;
+        return allocation;
+    }
+
+    void Free(GeometryAllocation &allocation) {
+        if (allocation._arena != this) {
+            return;
+        }
+
+        _vertices.Free(allocation._firstVertex, allocation._vertexCount);
+        _indices.Free(allocation._indexOffset, allocation._indexBytes);
+        allocation._arena = nullptr;
+    }
+
+    /**
+     * Deletes the GL objects. Only valid once every allocation has been freed.
+     */
+    void Release() {
+        if (_vertices.Used() || _indices.Used()) {
+            std::cout << "ERROR::GEOMETRY_ARENA::RELEASED_WHILE_IN_USE" << std::endl;
+        }
+
+        Render::StateCache &state = Render::StateCache::Shared();
+        state.ForgetVertexArray(_vertexArray);
+        state.ForgetBuffer(_vertexBuffer);
+        state.ForgetBuffer(_indexBuffer);
+        glDeleteVertexArrays(1, &_vertexArray);
+        glDeleteBuffers(1, &_vertexBuffer);
+        glDeleteBuffers(1, &_indexBuffer);
+        _vertexArray = _vertexBuffer = _indexBuffer = 0;
+        _vertices = RangeAllocator();
+        _indices = RangeAllocator();
+    }
+
+    void Bind() const { Render::StateCache::Shared().BindVertexArray(_vertexArray); }
+
+    GLuint VertexArray() const { return _vertexArray; }
+
+    VertexFormat Format() const { return _format; }
+
+    size_t VertexCapacity() const { return _vertices.Capacity(); }
+
+    size_t VerticesUsed() const { return _vertices.Used(); }
+
+    size_t IndexCapacity() const { return _indices.Capacity(); }
+
+    size_t IndexBytesUsed() const { return _indices.Used(); }
+};
+
+inline GeometryAllocation &GeometryAllocation::operator=(GeometryAllocation &&other) noexcept {
+    if (this != &other) {
+        if (_arena) {
+            _arena->Free(*this);
+        }
+
+        _arena = std::exchange(other._arena, nullptr);
+        _firstVertex = other._firstVertex;
+        _vertexCount = other._vertexCount;
+        _indexOffset = other._indexOffset;
+        _indexBytes = other._indexBytes;
+    }
+
+    return *this;
+}
+
+inline GeometryAllocation::~GeometryAllocation() {
+    if (_arena) {
+        _arena->Free(*this);
+    }
+}
+} // namespace Buffers
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef BUFFERS_INDEX_DATA_H
+#define BUFFERS_INDEX_DATA_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "openGLCommon.hpp"
+
+namespace Buffers {
+// Meshes with at most this many vertices can be addressed with 16-bit indices
+constexpr size_t MAX_SHORT_INDEX_VERTICES = 65536;
+
+inline GLenum IndexTypeFor(size_t vertexCount) {
+    return vertexCount <= MAX_SHORT_INDEX_VERTICES ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+inline size_t IndexSize(GLenum type) { return type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t); }
+
+/**
+ * A triangle list stored at the narrowest index width its vertex count allows, ready for `glBufferData` and the
+ * matching `glDrawElements` type.
+ */
+class IndexData {
+private:
+    std::vector<unsigned char> _bytes;
+    size_t _count = 0;
+    GLenum _type = GL_UNSIGNED_INT;
+
+public:
+    IndexData() = default;
+
+    IndexData(const GLuint *indices, size_t count, size_t vertexCount) :
+        _bytes(count * Buffers::IndexSize(IndexTypeFor(vertexCount))),
+        _count(count),
+        _type(IndexTypeFor(vertexCount)) {
+        if (_type == GL_UNSIGNED_INT) {
+            std::memcpy(_bytes.data(), indices, _bytes.size());
+            return;
+        }
+
+        uint16_t *narrow = reinterpret_cast<uint16_t *>(_bytes.data());
+
+        for (size_t i = 0; i < count; ++i) {
+            narrow[i] = static_cast<uint16_t>(indices[i]);
+        }
+    }
+
+    GLenum Type() const { return _type; }
+
+    size_t IndexSize() const { return Buffers::IndexSize(_type); }
+
+    size_t Count() const { return _count; }
+
+    size_t Bytes() const { return _bytes.size(); }
+
+    const void *Data() const { return _bytes.data(); }
+
+    GLuint operator[](size_t i) const {
+        if (_type == GL_UNSIGNED_SHORT) {
+            uint16_t index;
+            std::memcpy(&index, _bytes.data() + i * sizeof(uint16_t), sizeof(index));
+            return index;
+        }
+
+        GLuint index;
+        std::memcpy(&index, _bytes.data() + i * sizeof(GLuint), sizeof(index));
+        return index;
+    }
+};
+} // namespace Buffers
+
+#endif
@@ -0,0 +1,110 @@
+/**
+ * @file First-fit free-list allocator over an abstract range [0, capacity), used to sub-allocate large GL buffers.
+ *
+ * Free blocks are kept sorted by offset so freeing coalesces with both neighbours in O(log n). The allocator never
+ * touches memory itself; offsets and sizes are in whatever unit the caller chooses (vertices, bytes).
+ */
+
+#ifndef BUFFERS_RANGE_ALLOCATOR_H
+#define BUFFERS_RANGE_ALLOCATOR_H
+
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <map>
+
+namespace Buffers {
+class RangeAllocator {
+private:
+    // Offset to size of every free block
+    std::map<size_t, size_t> _free;
+    size_t _capacity = 0;
+    size_t _used = 0;
+
+    void Insert(size_t offset, size_t size) {
+        if (size == 0) {
+            return;
+        }
+
+        auto next = _free.lower_bound(offset);
+
+        if (next != _free.end() && offset + size == next->first) {
+            size += next->second;
+            next = _free.erase(next);
+        }
+
+        if (next != _free.begin()) {
+            auto previous = std::prev(next);
+
+            if (previous->first + previous->second == offset) {
+                previous->second += size;
+                return;
+            }
+        }
+
+        _free.emplace_hint(next, offset, size);
+    }
+
+public:
+    static constexpr size_t INVALID_OFFSET = std::numeric_limits<size_t>::max();
+
+    explicit RangeAllocator(size_t capacity = 0) { Grow(capacity); }
+
+    /**
+     * Returns the offset of `size` units aligned to `alignment`, or `INVALID_OFFSET` if no free block fits.
+     */
+    size_t Allocate(size_t size, size_t alignment = 1) {
+        if (size == 0) {
+            return 0;
+        }
+
+        for (auto block = _free.begin(); block != _free.end(); ++block) {
+            const size_t offset = (block->first + alignment - 1) / alignment * alignment;
+            const size_t padding = offset - block->first;
+
+            if (padding > block->second || block->second - padding < size) {
+                continue;
+            }
+
+            const size_t blockOffset = block->first;
+            const size_t blockSize = block->second;
+            _free.erase(block);
+
+            Insert(blockOffset, padding);
+            Insert(offset + size, blockSize - padding - size);
+
+            _used += size;
+            return offset;
+        }
+
+        return INVALID_OFFSET;
+    }
+
+    void Free(size_t offset, size_t size) {
+        if (size == 0) {
+            return;
+        }
+
+        _used -= size;
+        Insert(offset, size);
+    }
+
+    // Extends the range; existing allocations keep their offsets
+    void Grow(size_t capacity) {
+        if (capacity <= _capacity) {
+            return;
+        }
+
+        Insert(_capacity, capacity - _capacity);
+        _capacity = capacity;
+    }
+
+    size_t Capacity() const { return _capacity; }
+
+    size_t Used() const { return _used; }
+
+    size_t FreeBlocks() const { return _free.size(); }
+};
+} // namespace Buffers
+
+#endif
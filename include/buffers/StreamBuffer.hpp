@@ -0,0 +1,42 @@
+/**
+ * @file Uploads for buffers rewritten from scratch every frame.
+ *
+ * Respecifying the whole store with `glBufferData` orphans the previous one, so the driver hands back fresh memory
+ * rather than waiting on draws that are still reading the old contents. The store only ever grows, at least doubling,
+ * so a steady frame respecifies the same size every time.
+ */
+
+#ifndef BUFFERS_STREAM_BUFFER_H
+#define BUFFERS_STREAM_BUFFER_H
+
+#include <algorithm>
+#include <cstddef>
+
+#include "render/StateCache.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Buffers {
+/**
+ * Binds `buffer` to `target` and orphans its store, growing `capacity` to at least `minimum` bytes when `bytes` don't
+ * fit. The caller then writes up to `capacity` bytes with `glBufferSubData`.
+ */
+inline void OrphanStream(GLenum target, GLuint buffer, size_t &capacity, size_t bytes, size_t minimum) {
+    Render::StateCache::Shared().BindBuffer(target, buffer);
+
+    if (bytes > capacity) {
+        capacity = std::max({bytes, capacity * 2, minimum});
+    }
+
+    glBufferData(target, capacity, nullptr, GL_STREAM_DRAW);
+}
+
+// Orphans the store as `OrphanStream` does, then writes `bytes` of `data` at its start
+inline void
+UploadStream(GLenum target, GLuint buffer, size_t &capacity, const void *data, size_t bytes, size_t minimum) {
+    OrphanStream(target, buffer, capacity, bytes, minimum);
+    glBufferSubData(target, 0, bytes, data);
+}
+} // namespace Buffers
+
+#endif
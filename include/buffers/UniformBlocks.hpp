@@ -0,0 +1,233 @@
+/**
+ * @file std140 mirrors of the `Camera` and `Lights` uniform blocks, and the buffer every program reads them from.
+ *
+ * Both blocks live in one buffer, each at a fixed binding point, so a frame uploads its camera and lights with a
+ * single `glBufferSubData` however many programs read them, or writes them straight into a `FrameRingBuffer`. std140
+ * rounds every vec3 and struct up to 16 bytes; the structs below spell out that padding, and the static_asserts pin
+ * every offset to the GLSL declarations in `shaders/`.
+ */
+
+#ifndef BUFFERS_UNIFORM_BLOCKS_H
+#define BUFFERS_UNIFORM_BLOCKS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "buffers/FrameRingBuffer.hpp"
+#include "colors/Color.hpp"
+#include "lights/Attenuation.hpp"
+#include "lights/DirectionalLight.hpp"
+#include "lights/PointLight.hpp"
+#include "lights/SpotLight.hpp"
+#include "render/StateCache.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Buffers {
+constexpr GLuint CAMERA_BLOCK_BINDING = 0;
+constexpr GLuint LIGHT_BLOCK_BINDING = 1;
+
+constexpr const char *CAMERA_BLOCK_NAME = "Camera";
+constexpr const char *LIGHT_BLOCK_NAME = "Lights";
+
+// Must match MAX_NUM_POINT_LIGHTS in the shaders
+constexpr size_t MAX_POINT_LIGHTS = 4;
+
+struct Std140Color {
+    glm::vec4 Ambient = glm::vec4(0.0f);
+    glm::vec4 Diffuse = glm::vec4(0.0f);
+    glm::vec4 Specular = glm::vec4(0.0f);
+
+    Std140Color() = default;
+
+    explicit Std140Color(const Color::Color &color) :
+        Ambient(color.ambient, 0.0f), Diffuse(color.diffuse, 0.0f), Specular(color.specular, 0.0f) {}
+};
+
+struct Std140Attenuation {
+    float Constant = 1.0f;
+    float Linear = 0.0f;
+    float Quadratic = 0.0f;
+    float Padding = 0.0f;
+
+    Std140Attenuation() = default;
+
+    explicit Std140Attenuation(const Light::Attenuation &attenuation) :
+        Constant(attenuation.constant), Linear(attenuation.linear), Quadratic(attenuation.quadratic) {}
+};
+
+struct Std140DirectionalLight {
+    Std140Color Color;
+    glm::vec4 Direction = glm::vec4(0.0f);
+
+    Std140DirectionalLight() = default;
+
+    explicit Std140DirectionalLight(const Light::DirectionalLight &light) :
+        Color(light.color), Direction(light.direction, 0.0f) {}
+};
+
+struct Std140PointLight {
+    Std140Color Color;
+    Std140Attenuation Attenuation;
+    glm::vec4 Position = glm::vec4(0.0f);
+
+    Std140PointLight() = default;
+
+    explicit Std140PointLight(const Light::PointLight &light) :
+        Color(light.color), Attenuation(light.attenuation), Position(light.position, 1.0f) {}
+};
+
+struct Std140SpotLight {
+    Std140Color Color;
+    Std140Attenuation Attenuation;
+    glm::vec3 Position = glm::vec3(0.0f);
+    float Padding0 = 0.0f;
+    // The floats after a vec3 fill its last four bytes
+    glm::vec3 Direction = glm::vec3(0.0f);
+    float InnerRadius = 0.0f;
+    float OuterRadius = 0.0f;
+    float Padding1[3] = {};
+
+    Std140SpotLight() = default;
+
+    explicit Std140SpotLight(const Light::SpotLight &light) :
+        Color(light.color),
+        Attenuation(light.attenuation),
+        Position(light.position),
+        Direction(light.direction),
+        InnerRadius(light.innerRadius),
+        OuterRadius(light.outerRadius) {}
+};
+
+struct CameraBlock {
+    glm::mat4 View = glm::mat4(1.0f);
+    glm::mat4 Projection = glm::mat4(1.0f);
+    glm::vec4 ViewPosition = glm::vec4(0.0f);
+};
+
+struct LightBlock {
+    Std140DirectionalLight DirectionalLight;
+    Std140SpotLight SpotLight;
+    Std140PointLight PointLights[MAX_POINT_LIGHTS];
+    int32_t NumPointLights = 0;
+    int32_t Padding[3] = {};
+
+    void SetPointLights(const std::vector<Light::PointLight> &lights) {
+        NumPointLights = static_cast<int32_t>(std::min(lights.size(), MAX_POINT_LIGHTS));
+
+        for (int32_t i = 0; i < NumPointLights; ++i) {
+            PointLights[i] = Std140PointLight(lights[i]);
+        }
+    }
+};
+
+static_assert(sizeof(Std140Color) == 48, "std140 Color is three padded vec3s");
+static_assert(sizeof(Std140Attenuation) == 16, "std140 structs round up to 16 bytes");
+static_assert(sizeof(Std140DirectionalLight) == 64, "std140 DirectionalLight layout");
+static_assert(offsetof(Std140PointLight, Attenuation) == 48, "std140 PointLight layout");
+static_assert(offsetof(Std140PointLight, Position) == 64, "std140 PointLight layout");
+static_assert(sizeof(Std140PointLight) == 80, "std140 PointLight layout");
+static_assert(offsetof(Std140SpotLight, Position) == 64, "std140 SpotLight layout");
+static_assert(offsetof(Std140SpotLight, Direction) == 80, "std140 SpotLight layout");
+static_assert(offsetof(Std140SpotLight, InnerRadius) == 92, "std140 SpotLight layout");
+static_assert(offsetof(Std140SpotLight, OuterRadius) == 96, "std140 SpotLight layout");
+static_assert(sizeof(Std140SpotLight) == 112, "std140 SpotLight layout");
+static_assert(offsetof(CameraBlock, Projection) == 64, "std140 Camera layout");
+static_assert(offsetof(CameraBlock, ViewPosition) == 128, "std140 Camera layout");
+static_assert(sizeof(CameraBlock) == 144, "std140 Camera layout");
+static_assert(offsetof(LightBlock, SpotLight) == 64, "std140 Lights layout");
+static_assert(offsetof(LightBlock, PointLights) == 176, "std140 Lights layout");
+static_assert(offsetof(LightBlock, NumPointLights) == 176 + 80 * MAX_POINT_LIGHTS, "std140 Lights layout");
+static_assert(sizeof(LightBlock) % 16 == 0, "std140 blocks round up to 16 bytes");
+
+/**
+ * The buffer behind both blocks, with the light block placed at the driver's uniform buffer offset alignment.
+ */
+class FrameUniforms {
+private:
+    GLuint _buffer = 0;
+    size_t _alignment = 1;
+    size_t _lightOffset = 0;
+    std::vector<unsigned char> _staging;
+    // Whether the binding points were last moved into a ring buffer, away from `_buffer`
+    bool _boundToRing = false;
+
+    void bindOwnBuffer() const {
+        Render::StateCache &state = Render::StateCache::Shared();
+        state.BindBufferRange(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, _buffer, 0, sizeof(CameraBlock));
+        state.BindBufferRange(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING, _buffer, _lightOffset, sizeof(LightBlock));
+    }
+
+public:
+    CameraBlock Camera;
+    LightBlock Lights;
+
+    FrameUniforms() {
+        GLint alignment = 1;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        _alignment = static_cast<size_t>(std::max(alignment, 1));
+
+        _lightOffset = (sizeof(CameraBlock) + _alignment - 1) / _alignment * _alignment;
+        _staging.resize(_lightOffset + sizeof(LightBlock));
+
+        glGenBuffers(1, &_buffer);
+        Render::StateCache::Shared().BindBuffer(GL_UNIFORM_BUFFER, _buffer);
+        glBufferData(GL_UNIFORM_BUFFER, _staging.size(), nullptr, GL_DYNAMIC_DRAW);
+
+        bindOwnBuffer();
+    }
+
+    FrameUniforms(const FrameUniforms &) = delete;
+    FrameUniforms &operator=(const FrameUniforms &) = delete;
+
+    ~FrameUniforms() {
+        Render::StateCache::Shared().ForgetBuffer(_buffer);
+        glDeleteBuffers(1, &_buffer);
+    }
+
+    // Sends both blocks to the GPU in one update
+    void Upload() {
+        std::memcpy(_staging.data(), &Camera, sizeof(CameraBlock));
+        std::memcpy(_staging.data() + _lightOffset, &Lights, sizeof(LightBlock));
+
+        Render::StateCache::Shared().BindBuffer(GL_UNIFORM_BUFFER, _buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, _staging.size(), _staging.data());
+
+        if (_boundToRing) {
+            bindOwnBuffer();
+            _boundToRing = false;
+        }
+    }
+
+    /**
+     * Writes both blocks into this frame's part of `ring` and points the binding points at them there. Falls back to
+     * the own buffer when the ring is full.
+     */
+    void Upload(FrameRingBuffer &ring) {
+        const RingAllocation camera = ring.Allocate(sizeof(CameraBlock), _alignment);
+        const RingAllocation lights = ring.Allocate(sizeof(LightBlock), _alignment);
+
+        if (!camera.Pointer || !lights.Pointer) {
+            Upload();
+            return;
+        }
+
+        std::memcpy(camera.Pointer, &Camera, sizeof(CameraBlock));
+        std::memcpy(lights.Pointer, &Lights, sizeof(LightBlock));
+
+        Render::StateCache &state = Render::StateCache::Shared();
+        state.BindBufferRange(
+            GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, camera.Buffer, camera.Offset, sizeof(CameraBlock)
+        );
+        state.BindBufferRange(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING, lights.Buffer, lights.Offset, sizeof(LightBlock));
+        _boundToRing = true;
+    }
+};
+} // namespace Buffers
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef BUFFERS_VERTEX_FORMAT_H
+#define BUFFERS_VERTEX_FORMAT_H
+
+#include <cstddef>
+
+#include "packedVertex.hpp"
+#include "vertex.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Buffers {
+enum class VertexFormat { Full, Packed };
+
+inline size_t VertexStride(VertexFormat format) {
+    return format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+}
+
+/**
+ * Points the attributes of `format` at the buffer bound to GL_ARRAY_BUFFER, for the bound vertex array. The packed
+ * format uses its own attribute locations, so one shader can draw both.
+ */
+inline void BindVertexAttributes(VertexFormat format) {
+    if (format == VertexFormat::Full) {
+        // Vertex positions
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
+
+        // Vertex normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Normal));
+
+        // Vertex Texture Coordinates
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, TextureCoordinates));
+
+        // Vertex Tangent
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Tangent));
+
+        // Vertex BitTangent
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, BitTangent));
+        return;
+    }
+
+    // Quantised positions, with the bitangent sign in w
+    glEnableVertexAttribArray(5);
+    glVertexAttribPointer(5, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void *)0);
+
+    // Half float texture coordinates, at the same location as the float layout's
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(
+        2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void *)offsetof(PackedVertex, TextureCoordinates)
+    );
+
+    // Octahedral normal
+    glEnableVertexAttribArray(6);
+    glVertexAttribPointer(6, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void *)offsetof(PackedVertex, Normal));
+
+    // Octahedral tangent
+    glEnableVertexAttribArray(7);
+    glVertexAttribPointer(7, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void *)offsetof(PackedVertex, Tangent));
+}
+} // namespace Buffers
+
+#endif
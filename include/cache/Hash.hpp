@@ -0,0 +1,45 @@
+#ifndef CACHE_HASH_H
+#define CACHE_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "cache/MappedFile.hpp"
+
+namespace Cache {
+constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+inline uint64_t HashBytes(const unsigned char *data, size_t size, uint64_t hash = FNV_OFFSET_BASIS) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+// Hashes the length before the characters, so consecutive strings can't run into each other
+inline uint64_t HashString(std::string_view text, uint64_t hash = FNV_OFFSET_BASIS) {
+    const uint64_t length = text.size();
+    hash = HashBytes(reinterpret_cast<const unsigned char *>(&length), sizeof(length), hash);
+    return HashBytes(reinterpret_cast<const unsigned char *>(text.data()), text.size(), hash);
+}
+
+/**
+ * FNV-1a hash of a file's contents, or 0 if the file cannot be read.
+ */
+inline uint64_t HashFile(const std::string &path) {
+    MappedFile file(path);
+
+    if (!file.IsOpen()) {
+        return 0;
+    }
+
+    return HashBytes(file.Data(), file.Size());
+}
+} // namespace Cache
+
+#endif
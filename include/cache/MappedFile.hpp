@@ -0,0 +1,122 @@
+/**
+ * @file Read-only memory mapping of a whole file
+ */
+
+#ifndef CACHE_MAPPED_FILE_H
+#define CACHE_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Cache {
+class MappedFile {
+private:
+    const unsigned char *_data = nullptr;
+    size_t _size = 0;
+
+#ifdef _WIN32
+    HANDLE _file = INVALID_HANDLE_VALUE;
+    HANDLE _mapping = NULL;
+#else
+    int _file = -1;
+#endif
+
+    void Close() {
+#ifdef _WIN32
+        if (_data) {
+            UnmapViewOfFile(_data);
+        }
+        if (_mapping) {
+            CloseHandle(_mapping);
+        }
+        if (_file != INVALID_HANDLE_VALUE) {
+            CloseHandle(_file);
+        }
+        _file = INVALID_HANDLE_VALUE;
+        _mapping = NULL;
+#else
+        if (_data) {
+            munmap(const_cast<unsigned char *>(_data), _size);
+        }
+        if (_file >= 0) {
+            close(_file);
+        }
+        _file = -1;
+#endif
+        _data = nullptr;
+        _size = 0;
+    }
+
+public:
+    explicit MappedFile(const std::string &path) {
+#ifdef _WIN32
+        _file = CreateFileA(
+            path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL
+        );
+        LARGE_INTEGER size;
+
+        if (_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(_file, &size) || size.QuadPart == 0) {
+            Close();
+            return;
+        }
+
+        _mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        void *view = _mapping ? MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+
+        if (!view) {
+            Close();
+            return;
+        }
+
+        _data = static_cast<const unsigned char *>(view);
+        _size = static_cast<size_t>(size.QuadPart);
+#else
+        _file = open(path.c_str(), O_RDONLY);
+        struct stat info;
+
+        if (_file < 0 || fstat(_file, &info) != 0 || info.st_size == 0) {
+            Close();
+            return;
+        }
+
+        void *view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, _file, 0);
+
+        if (view == MAP_FAILED) {
+            Close();
+            return;
+        }
+
+        _data = static_cast<const unsigned char *>(view);
+        _size = static_cast<size_t>(info.st_size);
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile() { Close(); }
+
+    bool IsOpen() const { return _data != nullptr; }
+
+    const unsigned char *Data() const { return _data; }
+
+    size_t Size() const { return _size; }
+};
+} // namespace Cache
+
+#endif
@@ -0,0 +1,370 @@
+/**
+ * @file Versioned binary cache of a model's converted meshes.
+ *
+ * The cache holds exactly what `Model::processMesh` produces, in native byte order:
+ *
+ *   header | dependency 0 | dependency 1 | ... | mesh record 0 | mesh record 1 | ...
+ *
+ * where each mesh record is a small fixed header, its texture references, LOD ranges and meshlets, then the vertex
+ * and index arrays padded so they can be handed to `glBufferData` straight out of the mapping. A cache is only used
+ * when its format version, vertex size, source file hash, importer flags and post-import stages all match the current
+ * import. The dependencies are the other files the importer read, such as an OBJ's material library, each with the
+ * hash it had; the cache is stale as soon as any of them changes.
+ */
+
+#ifndef CACHE_MODEL_CACHE_H
+#define CACHE_MODEL_CACHE_H
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cache/Hash.hpp"
+#include "cache/MappedFile.hpp"
+#include "geometry/Lod.hpp"
+#include "geometry/Meshlets.hpp"
+#include "meshData.hpp"
+#include "texture.hpp"
+#include "vertex.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Cache {
+constexpr char MODEL_CACHE_MAGIC[8] = {'L', 'O', 'G', 'L', 'M', 'D', 'L', '\0'};
+constexpr uint32_t MODEL_CACHE_VERSION = 6;
+constexpr size_t MODEL_CACHE_ALIGNMENT = 8;
+
+struct ModelCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t vertexSize;
+    uint64_t sourceHash;
+    uint32_t importFlags;
+    uint32_t meshCount;
+    // Bit set of the optional stages Model ran after Assimp, since they change the cached output
+    uint32_t stageFlags;
+    // Settings of those stages that a flag can't describe, such as the bits of the weld tolerance
+    uint32_t stageParameters;
+    uint32_t dependencyCount;
+    uint32_t padding;
+};
+
+struct DependencyRecordHeader {
+    uint64_t hash;
+    uint32_t pathLength;
+    uint32_t padding;
+};
+
+struct MeshRecordHeader {
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    float shininess;
+    uint32_t textureCount;
+    uint32_t lodCount;
+    uint32_t meshletCount;
+};
+
+struct TextureRecordHeader {
+    uint32_t typeLength;
+    uint32_t pathLength;
+};
+
+static_assert(MODEL_CACHE_ALIGNMENT % alignof(Vertex) == 0, "cached vertices must stay aligned");
+static_assert(MODEL_CACHE_ALIGNMENT % alignof(GLuint) == 0, "cached indices must stay aligned");
+
+inline size_t AlignOffset(size_t offset) {
+    return (offset + MODEL_CACHE_ALIGNMENT - 1) & ~(MODEL_CACHE_ALIGNMENT - 1);
+}
+
+inline std::string ModelCachePath(const std::string &sourcePath) { return sourcePath + ".meshcache"; }
+
+/**
+ * A mesh restored from the cache. The vertex and index pointers alias the mapping and are only valid for the
+ * lifetime of the `ModelCacheReader` that produced them.
+ */
+struct CachedMesh {
+    const Vertex *Vertices;
+    size_t VertexCount;
+    const GLuint *Indices;
+    size_t IndexCount;
+    std::vector<Geometry::MeshLod> Lods;
+    std::vector<Geometry::Meshlet> Meshlets;
+    std::vector<TextureReference> Textures;
+    GLfloat Shininess;
+};
+
+class ModelCacheReader {
+private:
+    MappedFile _file;
+    std::vector<CachedMesh> _meshes;
+    bool _valid = false;
+
+    bool Parse(uint64_t sourceHash, uint32_t importFlags, uint32_t stageFlags, uint32_t stageParameters) {
+        const unsigned char *data = _file.Data();
+        const size_t size = _file.Size();
+        size_t offset = 0;
+
+        auto read = [&](void *destination, size_t length) {
+            if (length > size - offset) {
+                return false;
+            }
+
+            std::memcpy(destination, data + offset, length);
+            offset += length;
+            return true;
+        };
+
+        // Whether what is left could hold `count` records of at least `recordSize` bytes, checked before a count read
+        // from the file sizes an allocation
+        auto fits = [&](size_t count, size_t recordSize) { return count <= (size - offset) / recordSize; };
+
+        ModelCacheHeader header;
+
+        if (!read(&header, sizeof(header)) || std::memcmp(header.magic, MODEL_CACHE_MAGIC, sizeof(header.magic)) ||
+            header.version != MODEL_CACHE_VERSION || header.vertexSize != sizeof(Vertex) ||
+            header.sourceHash != sourceHash || header.importFlags != importFlags || header.stageFlags != stageFlags ||
+            header.stageParameters != stageParameters) {
+            return false;
+        }
+
+        for (uint32_t i = 0; i < header.dependencyCount; ++i) {
+            DependencyRecordHeader dependency;
+
+            if (!read(&dependency, sizeof(dependency)) || dependency.pathLength > size - offset) {
+                return false;
+            }
+
+            const std::string dependencyPath(reinterpret_cast<const char *>(data + offset), dependency.pathLength);
+            offset += dependency.pathLength;
+
+            if (HashFile(dependencyPath) != dependency.hash) {
+                return false;
+            }
+        }
+
+        if (!fits(header.meshCount, sizeof(MeshRecordHeader))) {
+            return false;
+        }
+
+        _meshes.reserve(header.meshCount);
+
+        for (uint32_t i = 0; i < header.meshCount; ++i) {
+            MeshRecordHeader record;
+
+            if (!read(&record, sizeof(record)) || !fits(record.textureCount, sizeof(TextureRecordHeader))) {
+                return false;
+            }
+
+            std::vector<TextureReference> textures;
+            textures.reserve(record.textureCount);
+
+            for (uint32_t t = 0; t < record.textureCount; ++t) {
+                TextureRecordHeader texture;
+
+                if (!read(&texture, sizeof(texture)) ||
+                    static_cast<size_t>(texture.typeLength) + texture.pathLength > size - offset) {
+                    return false;
+                }
+
+                const char *text = reinterpret_cast<const char *>(data + offset);
+                textures.emplace_back(
+                    std::string(text, texture.typeLength), std::string(text + texture.typeLength, texture.pathLength)
+                );
+                offset += texture.typeLength + texture.pathLength;
+            }
+
+            if (!fits(record.lodCount, sizeof(Geometry::MeshLod))) {
+                return false;
+            }
+
+            std::vector<Geometry::MeshLod> lods(record.lodCount);
+
+            if (record.lodCount && !read(lods.data(), lods.size() * sizeof(Geometry::MeshLod))) {
+                return false;
+            }
+
+            if (!fits(record.meshletCount, sizeof(Geometry::Meshlet))) {
+                return false;
+            }
+
+            std::vector<Geometry::Meshlet> meshlets(record.meshletCount);
+
+            if (record.meshletCount && !read(meshlets.data(), meshlets.size() * sizeof(Geometry::Meshlet))) {
+                return false;
+            }
+
+            auto inRange = [&record](uint32_t indexOffset, uint32_t indexCount) {
+                return indexOffset <= record.indexCount && indexCount <= record.indexCount - indexOffset;
+            };
+
+            for (const Geometry::MeshLod &lod : lods) {
+                if (!inRange(lod.IndexOffset, lod.IndexCount)) {
+                    return false;
+                }
+            }
+
+            for (const Geometry::Meshlet &meshlet : meshlets) {
+                if (!inRange(meshlet.IndexOffset, meshlet.IndexCount)) {
+                    return false;
+                }
+            }
+
+            const size_t vertexBytes = static_cast<size_t>(record.vertexCount) * sizeof(Vertex);
+            const size_t indexBytes = static_cast<size_t>(record.indexCount) * sizeof(GLuint);
+
+            offset = AlignOffset(offset);
+            if (offset > size || vertexBytes > size - offset) {
+                return false;
+            }
+            const Vertex *vertices = reinterpret_cast<const Vertex *>(data + offset);
+            offset += vertexBytes;
+
+            offset = AlignOffset(offset);
+            if (offset > size || indexBytes > size - offset) {
+                return false;
+            }
+            const GLuint *indices = reinterpret_cast<const GLuint *>(data + offset);
+            offset += indexBytes;
+
+            _meshes.push_back(
+                {vertices,
+                 record.vertexCount,
+                 indices,
+                 record.indexCount,
+                 std::move(lods),
+                 std::move(meshlets),
+                 std::move(textures),
+                 record.shininess}
+            );
+        }
+
+        return true;
+    }
+
+public:
+    ModelCacheReader(
+        const std::string &path,
+        uint64_t sourceHash,
+        uint32_t importFlags,
+        uint32_t stageFlags,
+        uint32_t stageParameters
+    ) :
+        _file(path) {
+        if (_file.IsOpen()) {
+            _valid = Parse(sourceHash, importFlags, stageFlags, stageParameters);
+        }
+
+        if (!_valid) {
+            _meshes.clear();
+        }
+    }
+
+    bool IsValid() const { return _valid; }
+
+    const std::vector<CachedMesh> &Meshes() const { return _meshes; }
+};
+
+/**
+ * Writes the cache to a temporary file and renames it into place, so a crash mid-write never leaves a truncated
+ * cache behind. `dependencies` are hashed as they are now, so later edits to them invalidate the cache.
+ */
+inline bool WriteModelCache(
+    const std::string &path,
+    uint64_t sourceHash,
+    uint32_t importFlags,
+    uint32_t stageFlags,
+    uint32_t stageParameters,
+    const std::vector<std::string> &dependencies,
+    const std::vector<MeshData> &meshes
+) {
+    const std::string temporaryPath = path + ".tmp";
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+    if (!file) {
+        std::cout << "ERROR::MODEL_CACHE::WRITE_FAILED\npath: " << path << std::endl;
+        return false;
+    }
+
+    size_t offset = 0;
+    const char padding[MODEL_CACHE_ALIGNMENT] = {};
+
+    auto write = [&](const void *source, size_t length) {
+        file.write(static_cast<const char *>(source), static_cast<std::streamsize>(length));
+        offset += length;
+    };
+
+    auto pad = [&]() { write(padding, AlignOffset(offset) - offset); };
+
+    ModelCacheHeader header;
+    std::memcpy(header.magic, MODEL_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MODEL_CACHE_VERSION;
+    header.vertexSize = sizeof(Vertex);
+    header.sourceHash = sourceHash;
+    header.importFlags = importFlags;
+    header.meshCount = static_cast<uint32_t>(meshes.size());
+    header.stageFlags = stageFlags;
+    header.stageParameters = stageParameters;
+    header.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    header.padding = 0;
+    write(&header, sizeof(header));
+
+    for (const std::string &dependency : dependencies) {
+        DependencyRecordHeader dependencyRecord = {HashFile(dependency), static_cast<uint32_t>(dependency.size()), 0};
+        write(&dependencyRecord, sizeof(dependencyRecord));
+        write(dependency.data(), dependency.size());
+    }
+
+    for (const MeshData &mesh : meshes) {
+        MeshRecordHeader record = {
+            static_cast<uint32_t>(mesh.Vertices.size()),
+            static_cast<uint32_t>(mesh.Indices.size()),
+            mesh.Shininess,
+            static_cast<uint32_t>(mesh.Textures.size()),
+            static_cast<uint32_t>(mesh.Lods.size()),
+            static_cast<uint32_t>(mesh.Meshlets.size())
+        };
+        write(&record, sizeof(record));
+
+        for (const TextureReference &texture : mesh.Textures) {
+            TextureRecordHeader textureRecord = {
+                static_cast<uint32_t>(texture.Type.size()), static_cast<uint32_t>(texture.Path.size())
+            };
+            write(&textureRecord, sizeof(textureRecord));
+            write(texture.Type.data(), texture.Type.size());
+            write(texture.Path.data(), texture.Path.size());
+        }
+
+        write(mesh.Lods.data(), mesh.Lods.size() * sizeof(Geometry::MeshLod));
+        write(mesh.Meshlets.data(), mesh.Meshlets.size() * sizeof(Geometry::Meshlet));
+
+        pad();
+        write(mesh.Vertices.data(), mesh.Vertices.size() * sizeof(Vertex));
+        pad();
+        write(mesh.Indices.data(), mesh.Indices.size() * sizeof(GLuint));
+    }
+
+    file.close();
+
+    if (!file) {
+        std::cout << "ERROR::MODEL_CACHE::WRITE_FAILED\npath: " << path << std::endl;
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+
+    if (error) {
+        std::cout << "ERROR::MODEL_CACHE::WRITE_FAILED\npath: " << path << "\nwhat: " << error.message() << std::endl;
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+
+    return true;
+}
+} // namespace Cache
+
+#endif
@@ -0,0 +1,172 @@
+/**
+ * @file On-disk cache of linked program binaries.
+ *
+ * A binary is only valid for the driver that produced it, so the key hashes the GLSL sources and permutation defines
+ * together with the GL vendor, renderer and version strings. Each cache file holds one binary:
+ *
+ *   header | binary
+ *
+ * Drivers may still reject a binary after an update that leaves those strings unchanged; callers then compile from
+ * source as if the cache were empty.
+ */
+
+#ifndef CACHE_PROGRAM_CACHE_H
+#define CACHE_PROGRAM_CACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cache/Hash.hpp"
+#include "cache/MappedFile.hpp"
+#include "openGLExtensions.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Cache {
+constexpr char PROGRAM_CACHE_MAGIC[8] = {'L', 'O', 'G', 'L', 'P', 'R', 'G', '\0'};
+constexpr uint32_t PROGRAM_CACHE_VERSION = 1;
+
+struct ProgramCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t binaryFormat;
+    uint64_t key;
+    uint64_t length;
+};
+
+struct ProgramCacheStatistics {
+    size_t Hits = 0;
+    size_t Misses = 0;
+    // Binaries the driver refused to load
+    size_t Rejected = 0;
+};
+
+// Totals over every program built this run
+inline ProgramCacheStatistics &ProgramCacheCounters() {
+    static ProgramCacheStatistics statistics;
+    return statistics;
+}
+
+inline uint64_t HashGLString(GLenum name, uint64_t hash) {
+    const GLubyte *value = glGetString(name);
+    return HashString(value ? reinterpret_cast<const char *>(value) : "", hash);
+}
+
+/**
+ * Identifies a program build: its sources, the defines it was specialised with, and the driver building it.
+ */
+inline uint64_t
+ProgramCacheKey(std::string_view vertexSource, std::string_view fragmentSource, std::string_view defines) {
+    uint64_t hash = HashString(vertexSource);
+    hash = HashString(fragmentSource, hash);
+    hash = HashString(defines, hash);
+    hash = HashGLString(GL_VENDOR, hash);
+    hash = HashGLString(GL_RENDERER, hash);
+    return HashGLString(GL_VERSION, hash);
+}
+
+inline std::string ProgramCachePath(const std::string &fragmentPath, uint64_t key) {
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+    return fragmentPath + "." + name + ".programcache";
+}
+
+/**
+ * Loads the binary stored for `key` into `program`. Returns true only if the driver accepted it and `program` is
+ * now linked.
+ */
+inline bool LoadProgramBinary(GLuint program, const std::string &path, uint64_t key) {
+    ProgramCacheStatistics &statistics = ProgramCacheCounters();
+    MappedFile file(path);
+    ProgramCacheHeader header;
+
+    if (!Extensions::ProgramBinarySupported || !file.IsOpen() || file.Size() < sizeof(header)) {
+        ++statistics.Misses;
+        return false;
+    }
+
+    std::memcpy(&header, file.Data(), sizeof(header));
+
+    if (std::memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic)) ||
+        header.version != PROGRAM_CACHE_VERSION || header.key != key || header.length != file.Size() - sizeof(header)) {
+        ++statistics.Misses;
+        return false;
+    }
+
+    Extensions::ProgramBinary(
+        program, header.binaryFormat, file.Data() + sizeof(header), static_cast<GLsizei>(header.length)
+    );
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+
+    if (!linked) {
+        ++statistics.Rejected;
+        return false;
+    }
+
+    ++statistics.Hits;
+    return true;
+}
+
+/**
+ * Stores the binary of the linked `program` under `key`, through a temporary file so readers never see half of one.
+ */
+inline bool SaveProgramBinary(GLuint program, const std::string &path, uint64_t key) {
+    if (!Extensions::ProgramBinarySupported) {
+        return false;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+    if (length <= 0) {
+        return false;
+    }
+
+    std::vector<unsigned char> binary(length);
+    GLsizei written = 0;
+    GLenum format = 0;
+    Extensions::GetProgramBinary(program, length, &written, &format, binary.data());
+
+    ProgramCacheHeader header;
+    std::memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+    header.version = PROGRAM_CACHE_VERSION;
+    header.binaryFormat = format;
+    header.key = key;
+    header.length = static_cast<uint64_t>(written);
+
+    const std::string temporaryPath = path + ".tmp";
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(binary.data()), written);
+    file.close();
+
+    std::error_code error;
+
+    if (!file) {
+        std::cout << "ERROR::PROGRAM_CACHE::WRITE_FAILED\npath: " << path << std::endl;
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+
+    std::filesystem::rename(temporaryPath, path, error);
+
+    if (error) {
+        std::cout << "ERROR::PROGRAM_CACHE::WRITE_FAILED\npath: " << path << "\nwhat: " << error.message() << std::endl;
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+
+    return true;
+}
+} // namespace Cache
+
+#endif
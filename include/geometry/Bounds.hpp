@@ -0,0 +1,93 @@
+#ifndef GEOMETRY_BOUNDS_H
+#define GEOMETRY_BOUNDS_H
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "vertex.hpp"
+
+namespace Geometry {
+struct BoundingSphere {
+    glm::vec3 Center = glm::vec3(0.0f);
+    float Radius = 0.0f;
+};
+
+/**
+ * Ritter's bounding sphere: seeded from the two most distant points found in two sweeps, then grown to cover every
+ * point. Within a few percent of the minimal sphere, in linear time. `positionAt(i)` returns the i-th point.
+ */
+template<typename PositionAt>
+BoundingSphere ComputeBoundingSphere(size_t count, PositionAt positionAt) {
+    BoundingSphere sphere;
+
+    if (count == 0) {
+        return sphere;
+    }
+
+    auto farthestFrom = [&](const glm::vec3 &point) {
+        glm::vec3 farthest = point;
+        float farthestDistance = -1.0f;
+
+        for (size_t i = 0; i < count; ++i) {
+            const glm::vec3 offset = positionAt(i) - point;
+            const float distance = glm::dot(offset, offset);
+
+            if (distance > farthestDistance) {
+                farthest = positionAt(i);
+                farthestDistance = distance;
+            }
+        }
+
+        return farthest;
+    };
+
+    const glm::vec3 a = farthestFrom(positionAt(0));
+    const glm::vec3 b = farthestFrom(a);
+
+    sphere.Center = (a + b) * 0.5f;
+    sphere.Radius = glm::length(b - a) * 0.5f;
+
+    for (size_t i = 0; i < count; ++i) {
+        const glm::vec3 offset = positionAt(i) - sphere.Center;
+        const float distance = glm::length(offset);
+
+        if (distance > sphere.Radius) {
+            const float radius = (sphere.Radius + distance) * 0.5f;
+            sphere.Center += offset * ((radius - sphere.Radius) / distance);
+            sphere.Radius = radius;
+        }
+    }
+
+    return sphere;
+}
+
+inline BoundingSphere ComputeBoundingSphere(const Vertex *vertices, size_t count) {
+    return ComputeBoundingSphere(count, [vertices](size_t i) { return vertices[i].Position; });
+}
+
+/**
+ * Whether `transform` scales all three axes alike, which keeps normal cones and sphere radii exact in world space.
+ */
+inline bool HasUniformScale(const glm::mat4 &transform, float tolerance = 1e-3f) {
+    const float x = glm::length(glm::vec3(transform[0]));
+    const float y = glm::length(glm::vec3(transform[1]));
+    const float z = glm::length(glm::vec3(transform[2]));
+
+    return std::abs(x - y) <= tolerance * x && std::abs(x - z) <= tolerance * x;
+}
+
+/**
+ * Largest axis scale of an affine transform, used to carry object-space distances into world space conservatively.
+ */
+inline float MaxScale(const glm::mat4 &transform) {
+    return std::sqrt(std::max(
+        {glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])),
+         glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])),
+         glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2]))}
+    ));
+}
+} // namespace Geometry
+
+#endif
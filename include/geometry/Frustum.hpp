@@ -0,0 +1,44 @@
+#ifndef GEOMETRY_FRUSTUM_H
+#define GEOMETRY_FRUSTUM_H
+
+#include <array>
+
+#include <glm/glm.hpp>
+
+namespace Geometry {
+/**
+ * The six clip planes of a view-projection matrix (Gribb and Hartmann), normalised so plane tests return distances in
+ * the matrix's input space.
+ */
+struct Frustum {
+    std::array<glm::vec4, 6> Planes;
+
+    static Frustum FromMatrix(const glm::mat4 &viewProjection) {
+        const glm::vec4 x(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+        const glm::vec4 y(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+        const glm::vec4 z(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+        const glm::vec4 w(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+        Frustum frustum;
+        frustum.Planes = {w + x, w - x, w + y, w - y, w + z, w - z};
+
+        for (glm::vec4 &plane : frustum.Planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+
+        return frustum;
+    }
+
+    bool IntersectsSphere(const glm::vec3 &center, float radius) const {
+        for (const glm::vec4 &plane : Planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+};
+} // namespace Geometry
+
+#endif
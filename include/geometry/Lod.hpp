@@ -0,0 +1,88 @@
+/**
+ * @file Discrete levels of detail for a mesh, stored as consecutive ranges of one index buffer over a shared vertex
+ * buffer, and picked per draw by how many pixels their simplification error would cover on screen.
+ */
+
+#ifndef GEOMETRY_LOD_H
+#define GEOMETRY_LOD_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "geometry/Simplifier.hpp"
+#include "vertex.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Geometry {
+// Including the full-detail mesh
+constexpr size_t MAX_MESH_LODS = 4;
+// Each level aims for this fraction of the previous level's triangles
+constexpr float LOD_TRIANGLE_RATIO = 0.5f;
+// A level that can't get below this fraction of the previous one isn't worth the memory
+constexpr float MIN_LOD_REDUCTION = 0.85f;
+constexpr float DEFAULT_LOD_PIXEL_ERROR = 1.0f;
+
+struct MeshLod {
+    uint32_t IndexOffset;
+    uint32_t IndexCount;
+    // Object-space distance between this level and the full-detail surface
+    float Error;
+};
+
+/**
+ * Simplifies `indices` into up to `MAX_MESH_LODS - 1` coarser levels, each from the full-detail mesh so errors don't
+ * compound. Stops early once simplification stalls, for example on meshes made entirely of seams.
+ */
+inline std::vector<SimplifiedIndices>
+GenerateLods(const std::vector<Vertex> &vertices, const std::vector<GLuint> &indices) {
+    std::vector<SimplifiedIndices> levels;
+    size_t previousCount = indices.size();
+    float previousError = 0.0f;
+
+    for (size_t level = 1; level < MAX_MESH_LODS; ++level) {
+        const size_t targetCount = static_cast<size_t>(previousCount / 3 * LOD_TRIANGLE_RATIO) * 3;
+        SimplifiedIndices simplified = Simplify(vertices, indices, targetCount);
+
+        if (simplified.Indices.empty() || simplified.Indices.size() > previousCount * MIN_LOD_REDUCTION) {
+            break;
+        }
+
+        simplified.Error = std::max(simplified.Error, previousError);
+        previousCount = simplified.Indices.size();
+        previousError = simplified.Error;
+        levels.push_back(std::move(simplified));
+    }
+
+    return levels;
+}
+
+/**
+ * Pixels per world unit at distance 1 for a perspective projection with vertical field of view `fieldOfView`.
+ */
+inline float ProjectionScale(float fieldOfView, float viewportHeight) {
+    return viewportHeight / (2.0f * std::tan(fieldOfView * 0.5f));
+}
+
+/**
+ * Index of the coarsest level whose error, scaled to world space and projected at `distance`, stays within
+ * `maxPixelError` pixels.
+ */
+inline size_t SelectLod(
+    const std::vector<MeshLod> &lods, float errorScale, float distance, float projectionScale, float maxPixelError
+) {
+    const float pixelsPerUnit = errorScale * projectionScale / std::max(distance, 1e-4f);
+
+    for (size_t level = lods.size(); level-- > 1;) {
+        if (lods[level].Error * pixelsPerUnit <= maxPixelError) {
+            return level;
+        }
+    }
+
+    return 0;
+}
+} // namespace Geometry
+
+#endif
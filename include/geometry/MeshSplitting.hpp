@@ -0,0 +1,76 @@
+#ifndef GEOMETRY_MESH_SPLITTING_H
+#define GEOMETRY_MESH_SPLITTING_H
+
+#include <cstddef>
+#include <limits>
+#include <memory_resource>
+#include <vector>
+
+#include "vertex.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Geometry {
+struct MeshPart {
+    std::vector<Vertex> Vertices;
+    std::vector<GLuint> Indices;
+};
+
+/**
+ * Cuts a triangle list into parts of at most `maxVertices` vertices each, in triangle order. Vertices on the cut are
+ * duplicated into every part that uses them. Scratch tables come from `memory`.
+ */
+inline std::vector<MeshPart> SplitByVertexCount(
+    const std::vector<Vertex> &vertices,
+    const std::vector<GLuint> &indices,
+    size_t maxVertices,
+    std::pmr::memory_resource *memory = std::pmr::get_default_resource()
+) {
+    constexpr GLuint UNASSIGNED = std::numeric_limits<GLuint>::max();
+
+    std::vector<MeshPart> parts(1);
+    std::pmr::vector<GLuint> remap(vertices.size(), UNASSIGNED, memory);
+    std::pmr::vector<GLuint> touched(memory);
+    touched.reserve(maxVertices);
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        size_t newVertices = 0;
+
+        for (size_t corner = 0; corner < 3; ++corner) {
+            newVertices += remap[indices[i + corner]] == UNASSIGNED;
+        }
+
+        if (parts.back().Vertices.size() + newVertices > maxVertices) {
+            for (GLuint vertex : touched) {
+                remap[vertex] = UNASSIGNED;
+            }
+
+            touched.clear();
+            parts.emplace_back();
+        }
+
+        MeshPart &part = parts.back();
+
+        for (size_t corner = 0; corner < 3; ++corner) {
+            const GLuint vertex = indices[i + corner];
+
+            if (remap[vertex] == UNASSIGNED) {
+                remap[vertex] = static_cast<GLuint>(part.Vertices.size());
+                part.Vertices.push_back(vertices[vertex]);
+                touched.push_back(vertex);
+            }
+
+            part.Indices.push_back(remap[vertex]);
+        }
+    }
+
+    return parts;
+}
+
+// Scratch memory `SplitByVertexCount` takes for `vertexCount` vertices and parts of at most `maxVertices`
+inline size_t SplitScratchBytes(size_t vertexCount, size_t maxVertices) {
+    return (vertexCount + maxVertices) * sizeof(GLuint) + 2 * alignof(std::max_align_t);
+}
+} // namespace Geometry
+
+#endif
@@ -0,0 +1,234 @@
+/**
+ * @file Splits a triangle list into small clusters ("meshlets") with their own bounds, so whole clusters can be culled
+ * on the CPU before draw submission.
+ *
+ * Clusters are consecutive runs of the index buffer, filled greedily in its existing order, which works best after
+ * the vertex cache optimisation has made that order local. A visible set therefore maps straight onto
+ * `glMultiDrawElementsBaseVertex` ranges without rewriting any indices.
+ */
+
+#ifndef GEOMETRY_MESHLETS_H
+#define GEOMETRY_MESHLETS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "geometry/Bounds.hpp"
+#include "geometry/Frustum.hpp"
+#include "vertex.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Geometry {
+constexpr size_t MAX_MESHLET_VERTICES = 64;
+constexpr size_t MAX_MESHLET_TRIANGLES = 124;
+// Cones whose normals spread wider than about 84 degrees from the axis can't be back-facing as a whole
+constexpr float MIN_CONE_SPREAD = 0.1f;
+
+struct Meshlet {
+    uint32_t IndexOffset;
+    uint32_t IndexCount;
+    glm::vec3 Center;
+    float Radius;
+    // Average facing of the triangles and the sine of their spread around it; a cutoff of 1 disables cone culling
+    glm::vec3 ConeAxis;
+    float ConeCutoff;
+};
+
+/**
+ * Cuts `indices[0, indexCount)` into meshlets of at most `MAX_MESHLET_VERTICES` unique vertices and
+ * `MAX_MESHLET_TRIANGLES` triangles, then computes each one's bounding sphere and normal cone.
+ */
+inline std::vector<Meshlet>
+BuildMeshlets(const std::vector<Vertex> &vertices, const std::vector<GLuint> &indices, size_t indexCount) {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> lastMeshlet(vertices.size(), std::numeric_limits<uint32_t>::max());
+    std::vector<glm::vec3> points;
+    points.reserve(MAX_MESHLET_VERTICES);
+
+    auto finish = [&](uint32_t offset, uint32_t end) {
+        Meshlet meshlet;
+        meshlet.IndexOffset = offset;
+        meshlet.IndexCount = end - offset;
+
+        const BoundingSphere sphere =
+            ComputeBoundingSphere(points.size(), [&points](size_t i) { return points[i]; });
+        meshlet.Center = sphere.Center;
+        meshlet.Radius = sphere.Radius;
+
+        glm::vec3 normalSum(0.0f);
+        std::vector<glm::vec3> normals;
+        normals.reserve(meshlet.IndexCount / 3);
+
+        for (uint32_t i = offset; i < end; i += 3) {
+            const glm::vec3 &p0 = vertices[indices[i]].Position;
+            const glm::vec3 normal =
+                glm::cross(vertices[indices[i + 1]].Position - p0, vertices[indices[i + 2]].Position - p0);
+            const float length = glm::length(normal);
+
+            if (length > 0.0f) {
+                normals.push_back(normal / length);
+                normalSum += normals.back();
+            }
+        }
+
+        const float sumLength = glm::length(normalSum);
+        float minDot = -1.0f;
+
+        if (sumLength > 0.0f) {
+            meshlet.ConeAxis = normalSum / sumLength;
+            minDot = 1.0f;
+
+            for (const glm::vec3 &normal : normals) {
+                minDot = std::min(minDot, glm::dot(meshlet.ConeAxis, normal));
+            }
+        }
+
+        if (minDot < MIN_CONE_SPREAD) {
+            meshlet.ConeAxis = glm::vec3(0.0f);
+            meshlet.ConeCutoff = 1.0f;
+        } else {
+            meshlet.ConeCutoff = std::sqrt(1.0f - minDot * minDot);
+        }
+
+        meshlets.push_back(meshlet);
+        points.clear();
+    };
+
+    uint32_t offset = 0;
+
+    for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+        const uint32_t current = static_cast<uint32_t>(meshlets.size());
+        size_t newVertices = 0;
+
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+            newVertices += lastMeshlet[indices[i + corner]] != current;
+        }
+
+        // Corners repeated within the triangle were counted twice, which only makes the cut slightly earlier
+        if (points.size() + newVertices > MAX_MESHLET_VERTICES || (i - offset) / 3 >= MAX_MESHLET_TRIANGLES) {
+            finish(offset, i);
+            offset = i;
+        }
+
+        const uint32_t meshletIndex = static_cast<uint32_t>(meshlets.size());
+
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+            const GLuint vertex = indices[i + corner];
+
+            if (lastMeshlet[vertex] != meshletIndex) {
+                lastMeshlet[vertex] = meshletIndex;
+                points.push_back(vertices[vertex].Position);
+            }
+        }
+    }
+
+    if (offset < indexCount) {
+        finish(offset, static_cast<uint32_t>(indexCount - indexCount % 3));
+    }
+
+    return meshlets;
+}
+
+/**
+ * Ranges of one mesh's indices to draw with `glMultiDrawElementsBaseVertex`, rebuilt every frame without reallocating.
+ */
+struct DrawRanges {
+    std::vector<GLsizei> Counts;
+    std::vector<const void *> Offsets;
+    std::vector<GLint> BaseVertices;
+
+    size_t IndexByteOffset = 0;
+    size_t IndexSize = sizeof(GLuint);
+    GLint BaseVertex = 0;
+
+    // Clears the ranges for a mesh whose indices start at `indexByteOffset` in the bound index buffer
+    void Begin(size_t indexByteOffset, size_t indexSize, GLint baseVertex) {
+        Counts.clear();
+        Offsets.clear();
+        BaseVertices.clear();
+        IndexByteOffset = indexByteOffset;
+        IndexSize = indexSize;
+        BaseVertex = baseVertex;
+    }
+
+    // Adjacent ranges are merged, so runs of visible meshlets become one draw
+    void Add(uint32_t indexOffset, uint32_t indexCount) {
+        const size_t byteOffset = IndexByteOffset + static_cast<size_t>(indexOffset) * IndexSize;
+        const char *offset = reinterpret_cast<const char *>(byteOffset);
+
+        if (!Counts.empty() &&
+            static_cast<const char *>(Offsets.back()) + static_cast<size_t>(Counts.back()) * IndexSize == offset) {
+            Counts.back() += static_cast<GLsizei>(indexCount);
+            return;
+        }
+
+        Counts.push_back(static_cast<GLsizei>(indexCount));
+        Offsets.push_back(offset);
+        BaseVertices.push_back(BaseVertex);
+    }
+};
+
+struct CullStatistics {
+    size_t Meshlets = 0;
+    size_t FrustumCulled = 0;
+    size_t BackfaceCulled = 0;
+
+    CullStatistics &operator+=(const CullStatistics &other) {
+        Meshlets += other.Meshlets;
+        FrustumCulled += other.FrustumCulled;
+        BackfaceCulled += other.BackfaceCulled;
+        return *this;
+    }
+};
+
+/**
+ * Appends the meshlets of a mesh drawn with `model` that survive the world-space `frustum` and, when the model scales
+ * uniformly, the back-facing cone test from `cameraPosition`.
+ */
+inline CullStatistics CullMeshlets(
+    const std::vector<Meshlet> &meshlets,
+    const glm::mat4 &model,
+    const Frustum &frustum,
+    const glm::vec3 &cameraPosition,
+    DrawRanges &ranges
+) {
+    CullStatistics statistics;
+    statistics.Meshlets = meshlets.size();
+
+    const float scale = MaxScale(model);
+    const bool coneCulling = HasUniformScale(model);
+    const glm::mat3 rotation = glm::mat3(model) / scale;
+
+    for (const Meshlet &meshlet : meshlets) {
+        const glm::vec3 center = glm::vec3(model * glm::vec4(meshlet.Center, 1.0f));
+        const float radius = meshlet.Radius * scale;
+
+        if (!frustum.IntersectsSphere(center, radius)) {
+            ++statistics.FrustumCulled;
+            continue;
+        }
+
+        if (coneCulling && meshlet.ConeCutoff < 1.0f) {
+            const glm::vec3 view = center - cameraPosition;
+            const glm::vec3 axis = rotation * meshlet.ConeAxis;
+
+            if (glm::dot(view, axis) >= meshlet.ConeCutoff * glm::length(view) + radius) {
+                ++statistics.BackfaceCulled;
+                continue;
+            }
+        }
+
+        ranges.Add(meshlet.IndexOffset, meshlet.IndexCount);
+    }
+
+    return statistics;
+}
+} // namespace Geometry
+
+#endif
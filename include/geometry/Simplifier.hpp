@@ -0,0 +1,427 @@
+/**
+ * @file Quadric error metric mesh simplification (Garland and Heckbert, "Surface Simplification Using Quadric Error
+ * Metrics").
+ *
+ * Edges are collapsed onto one of their endpoints rather than an optimal new position, so every simplified index
+ * buffer still addresses the original vertex buffer and all LODs of a mesh can share it. Collapses run in passes: each
+ * pass ranks every legal edge collapse by quadric error and applies the cheapest ones that don't touch each other.
+ *
+ * Attribute seams (UV or normal discontinuities, where several vertices share a position) and open borders may only
+ * collapse along themselves, which keeps texture charts and silhouettes intact.
+ */
+
+#ifndef GEOMETRY_SIMPLIFIER_H
+#define GEOMETRY_SIMPLIFIER_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "geometry/VertexWelding.hpp"
+#include "vertex.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Geometry {
+// Border edges are held in place by a plane through the edge, weighted well above the surface planes
+constexpr double BORDER_PLANE_WEIGHT = 10.0;
+
+/**
+ * Symmetric 4x4 matrix summing squared distances to a set of planes, weighted by triangle area.
+ */
+struct Quadric {
+    double A00 = 0.0, A01 = 0.0, A02 = 0.0, A03 = 0.0;
+    double A11 = 0.0, A12 = 0.0, A13 = 0.0;
+    double A22 = 0.0, A23 = 0.0;
+    double A33 = 0.0;
+    double Weight = 0.0;
+
+    static Quadric FromPlane(const glm::dvec3 &normal, double distance, double weight) {
+        Quadric q;
+        q.A00 = weight * normal.x * normal.x;
+        q.A01 = weight * normal.x * normal.y;
+        q.A02 = weight * normal.x * normal.z;
+        q.A03 = weight * normal.x * distance;
+        q.A11 = weight * normal.y * normal.y;
+        q.A12 = weight * normal.y * normal.z;
+        q.A13 = weight * normal.y * distance;
+        q.A22 = weight * normal.z * normal.z;
+        q.A23 = weight * normal.z * distance;
+        q.A33 = weight * distance * distance;
+        q.Weight = weight;
+        return q;
+    }
+
+    Quadric &operator+=(const Quadric &other) {
+        A00 += other.A00;
+        A01 += other.A01;
+        A02 += other.A02;
+        A03 += other.A03;
+        A11 += other.A11;
+        A12 += other.A12;
+        A13 += other.A13;
+        A22 += other.A22;
+        A23 += other.A23;
+        A33 += other.A33;
+        Weight += other.Weight;
+        return *this;
+    }
+
+    // Weighted mean squared distance from `p` to the planes
+    double Error(const glm::dvec3 &p) const {
+        const double error = A00 * p.x * p.x + A11 * p.y * p.y + A22 * p.z * p.z + A33 +
+                             2.0 * (A01 * p.x * p.y + A02 * p.x * p.z + A12 * p.y * p.z + A03 * p.x + A13 * p.y +
+                                    A23 * p.z);
+
+        return Weight > 0.0 ? std::max(error / Weight, 0.0) : 0.0;
+    }
+};
+
+struct SimplifiedIndices {
+    std::vector<GLuint> Indices;
+    // Largest distance, in object space, between the simplified and the original surface
+    float Error = 0.0f;
+};
+
+namespace Simplification {
+enum class VertexKind : uint8_t { Manifold, Border, Seam, Locked };
+
+struct Edge {
+    uint32_t Triangles = 0;
+    uint32_t FirstTriangle = 0;
+    GLuint WedgeLow = 0;
+    GLuint WedgeHigh = 0;
+    // Triangles on either side disagree on the attribute vertices at the ends
+    bool Seam = false;
+};
+
+struct Collapse {
+    GLuint From;
+    GLuint To;
+    uint32_t Triangles;
+    double Cost;
+};
+
+inline uint64_t EdgeKey(GLuint a, GLuint b) {
+    return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+}
+} // namespace Simplification
+
+/**
+ * Collapses edges of `indices` until at most `targetIndexCount` indices remain or the next collapse would move the
+ * surface by more than `maxError`. Returns the simplified triangle list and the error it reached.
+ */
+inline SimplifiedIndices Simplify(
+    const std::vector<Vertex> &vertices,
+    const std::vector<GLuint> &indices,
+    size_t targetIndexCount,
+    float maxError = FLT_MAX
+) {
+    using namespace Simplification;
+
+    static_assert(offsetof(Vertex, Position) == 0, "positions must lead the vertex to weld by prefix");
+
+    const size_t vertexCount = vertices.size();
+
+    // Attribute vertices that share a position are wedges of one position vertex; topology only looks at positions
+    const std::pmr::vector<GLuint> position = WeldPrefix<sizeof(glm::vec3)>(vertices);
+    const std::pmr::vector<GLuint> wedge = WeldPrefix<sizeof(Vertex)>(vertices);
+
+    SimplifiedIndices result;
+    result.Indices.reserve(indices.size());
+
+    for (GLuint index : indices) {
+        result.Indices.push_back(wedge[index]);
+    }
+
+    std::vector<GLuint> &current = result.Indices;
+
+    auto point = [&](GLuint vertex) { return glm::dvec3(vertices[vertex].Position); };
+
+    std::vector<Quadric> quadrics(vertexCount);
+    std::vector<VertexKind> kinds(vertexCount);
+    std::vector<size_t> adjacencyOffsets(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::unordered_map<uint64_t, Edge> edges;
+    std::vector<Collapse> collapses;
+    std::vector<GLuint> collapseTo(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    double resultError = 0.0;
+
+    const double maxCost = static_cast<double>(maxError) * maxError;
+    bool firstPass = true;
+
+    for (size_t t = 0; t < current.size() / 3; ++t) {
+        const glm::dvec3 p0 = point(current[t * 3]);
+        const glm::dvec3 p1 = point(current[t * 3 + 1]);
+        const glm::dvec3 p2 = point(current[t * 3 + 2]);
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        const double doubleArea = glm::length(normal);
+
+        if (doubleArea <= 0.0) {
+            continue;
+        }
+
+        normal /= doubleArea;
+        const Quadric plane = Quadric::FromPlane(normal, -glm::dot(normal, p0), doubleArea * 0.5);
+
+        for (size_t corner = 0; corner < 3; ++corner) {
+            quadrics[position[current[t * 3 + corner]]] += plane;
+        }
+    }
+
+    while (current.size() > targetIndexCount) {
+        const size_t triangleCount = current.size() / 3;
+
+        // Position vertex to triangle adjacency, packed as offsets into one array
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+
+        for (GLuint index : current) {
+            ++adjacencyOffsets[position[index] + 1];
+        }
+
+        std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+        adjacency.resize(current.size());
+        std::vector<size_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+        for (size_t t = 0; t < triangleCount; ++t) {
+            for (size_t corner = 0; corner < 3; ++corner) {
+                adjacency[fill[position[current[t * 3 + corner]]]++] = static_cast<uint32_t>(t);
+            }
+        }
+
+        edges.clear();
+        edges.reserve(current.size());
+
+        for (size_t t = 0; t < triangleCount; ++t) {
+            for (size_t corner = 0; corner < 3; ++corner) {
+                GLuint a = current[t * 3 + corner];
+                GLuint b = current[t * 3 + (corner + 1) % 3];
+
+                if (position[a] > position[b]) {
+                    std::swap(a, b);
+                }
+
+                Edge &edge = edges[EdgeKey(position[a], position[b])];
+
+                if (edge.Triangles == 0) {
+                    edge.FirstTriangle = static_cast<uint32_t>(t);
+                    edge.WedgeLow = a;
+                    edge.WedgeHigh = b;
+                } else if (edge.WedgeLow != a || edge.WedgeHigh != b) {
+                    edge.Seam = true;
+                }
+
+                ++edge.Triangles;
+            }
+        }
+
+        std::fill(kinds.begin(), kinds.end(), VertexKind::Manifold);
+
+        for (const auto &[key, edge] : edges) {
+            const GLuint low = static_cast<GLuint>(key >> 32);
+            const GLuint high = static_cast<GLuint>(key & 0xFFFFFFFFu);
+
+            for (GLuint end : {low, high}) {
+                if (edge.Triangles > 2) {
+                    kinds[end] = VertexKind::Locked;
+                } else if (edge.Triangles == 1 && kinds[end] != VertexKind::Locked) {
+                    kinds[end] = kinds[end] == VertexKind::Seam ? VertexKind::Locked : VertexKind::Border;
+                } else if (edge.Seam && kinds[end] != VertexKind::Locked) {
+                    kinds[end] = kinds[end] == VertexKind::Border ? VertexKind::Locked : VertexKind::Seam;
+                }
+            }
+
+            if (firstPass && edge.Triangles == 1) {
+                const glm::dvec3 p0 = point(edge.WedgeLow);
+                const glm::dvec3 p1 = point(edge.WedgeHigh);
+                const uint32_t triangle = edge.FirstTriangle;
+                glm::dvec3 faceNormal = glm::cross(
+                    point(current[triangle * 3 + 1]) - point(current[triangle * 3]),
+                    point(current[triangle * 3 + 2]) - point(current[triangle * 3])
+                );
+                glm::dvec3 planeNormal = glm::cross(p1 - p0, faceNormal);
+                const double length = glm::length(planeNormal);
+
+                if (length > 0.0) {
+                    planeNormal /= length;
+                    const double edgeLengthSquared = glm::dot(p1 - p0, p1 - p0);
+                    const Quadric plane = Quadric::FromPlane(
+                        planeNormal, -glm::dot(planeNormal, p0), BORDER_PLANE_WEIGHT * edgeLengthSquared
+                    );
+
+                    quadrics[low] += plane;
+                    quadrics[high] += plane;
+                }
+            }
+        }
+
+        firstPass = false;
+
+        auto canCollapse = [&](GLuint from, const Edge &edge) {
+            switch (kinds[from]) {
+            case VertexKind::Manifold:
+                return edge.Triangles == 2 && !edge.Seam;
+            case VertexKind::Border:
+                return edge.Triangles == 1;
+            case VertexKind::Seam:
+                return edge.Triangles == 2 && edge.Seam;
+            default:
+                return false;
+            }
+        };
+
+        collapses.clear();
+
+        for (const auto &[key, edge] : edges) {
+            const GLuint low = static_cast<GLuint>(key >> 32);
+            const GLuint high = static_cast<GLuint>(key & 0xFFFFFFFFu);
+
+            for (int direction = 0; direction < 2; ++direction) {
+                const GLuint from = direction ? high : low;
+                const GLuint to = direction ? low : high;
+
+                if (!canCollapse(from, edge)) {
+                    continue;
+                }
+
+                Quadric combined = quadrics[from];
+                combined += quadrics[to];
+                const double cost = combined.Error(point(to));
+
+                if (cost <= maxCost) {
+                    collapses.push_back({from, to, edge.Triangles, cost});
+                }
+            }
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) {
+            return a.Cost < b.Cost;
+        });
+
+        const size_t trianglesToRemove = (current.size() - targetIndexCount + 2) / 3;
+        size_t removed = 0;
+
+        std::iota(collapseTo.begin(), collapseTo.end(), 0);
+        std::fill(touched.begin(), touched.end(), false);
+
+        for (const Collapse &collapse : collapses) {
+            if (removed >= trianglesToRemove) {
+                break;
+            }
+
+            if (touched[collapse.From] || touched[collapse.To]) {
+                continue;
+            }
+
+            // Pair every wedge at `From` with the wedge it merges into, using the triangles on the collapsing edge
+            std::vector<std::pair<GLuint, GLuint>> wedgeMap;
+            bool valid = true;
+
+            for (size_t a = adjacencyOffsets[collapse.From]; a < adjacencyOffsets[collapse.From + 1]; ++a) {
+                const GLuint *triangle = &current[adjacency[a] * 3];
+                GLuint fromWedge = 0;
+                GLuint toWedge = 0;
+                bool hasTo = false;
+
+                for (size_t corner = 0; corner < 3; ++corner) {
+                    if (position[triangle[corner]] == collapse.From) {
+                        fromWedge = triangle[corner];
+                    } else if (position[triangle[corner]] == collapse.To) {
+                        toWedge = triangle[corner];
+                        hasTo = true;
+                    }
+                }
+
+                if (hasTo) {
+                    wedgeMap.emplace_back(fromWedge, toWedge);
+                }
+            }
+
+            for (size_t a = adjacencyOffsets[collapse.From]; valid && a < adjacencyOffsets[collapse.From + 1]; ++a) {
+                const GLuint *triangle = &current[adjacency[a] * 3];
+                glm::dvec3 before[3];
+                glm::dvec3 after[3];
+                bool hasTo = false;
+                bool mapped = false;
+
+                for (size_t corner = 0; corner < 3; ++corner) {
+                    before[corner] = after[corner] = point(triangle[corner]);
+
+                    if (position[triangle[corner]] == collapse.To) {
+                        hasTo = true;
+                    } else if (position[triangle[corner]] == collapse.From) {
+                        after[corner] = point(collapse.To);
+
+                        for (const auto &[fromWedge, toWedge] : wedgeMap) {
+                            mapped = mapped || fromWedge == triangle[corner];
+                        }
+                    }
+                }
+
+                if (hasTo) {
+                    continue;
+                }
+
+                // Every surviving triangle needs a wedge to move to, and must not flip or degenerate
+                const glm::dvec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                const glm::dvec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+
+                valid = mapped && glm::dot(normalBefore, normalAfter) > 0.0;
+            }
+
+            if (!valid) {
+                continue;
+            }
+
+            for (const auto &[fromWedge, toWedge] : wedgeMap) {
+                collapseTo[fromWedge] = toWedge;
+            }
+
+            for (size_t a = adjacencyOffsets[collapse.From]; a < adjacencyOffsets[collapse.From + 1]; ++a) {
+                for (size_t corner = 0; corner < 3; ++corner) {
+                    touched[position[current[adjacency[a] * 3 + corner]]] = true;
+                }
+            }
+
+            quadrics[collapse.To] += quadrics[collapse.From];
+            resultError = std::max(resultError, collapse.Cost);
+            removed += collapse.Triangles;
+        }
+
+        if (removed == 0) {
+            break;
+        }
+
+        size_t write = 0;
+
+        for (size_t t = 0; t < triangleCount; ++t) {
+            const GLuint a = collapseTo[current[t * 3]];
+            const GLuint b = collapseTo[current[t * 3 + 1]];
+            const GLuint c = collapseTo[current[t * 3 + 2]];
+
+            if (position[a] == position[b] || position[b] == position[c] || position[c] == position[a]) {
+                continue;
+            }
+
+            current[write++] = a;
+            current[write++] = b;
+            current[write++] = c;
+        }
+
+        current.resize(write);
+    }
+
+    result.Error = static_cast<float>(std::sqrt(resultError));
+    return result;
+}
+} // namespace Geometry
+
+#endif
@@ -0,0 +1,205 @@
+/**
+ * @file Reorders triangles and vertices of an indexed mesh for the GPU's vertex caches.
+ *
+ * Triangle order follows Tipsify (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and
+ * Reduced Overdraw"): it fans around one vertex at a time and picks the next fanning vertex among those still likely to
+ * be in a post-transform cache of the given size. Vertices are then renumbered in order of first use, so vertex fetch
+ * walks the buffer mostly forwards.
+ */
+
+#ifndef GEOMETRY_VERTEX_CACHE_OPTIMIZER_H
+#define GEOMETRY_VERTEX_CACHE_OPTIMIZER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "openGLCommon.hpp"
+
+namespace Geometry {
+constexpr size_t DEFAULT_VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStatistics {
+    size_t Triangles = 0;
+    size_t Vertices = 0;
+    size_t Misses = 0;
+
+    // Average cache miss ratio: transformed vertices per triangle, 3 at worst and about 0.5 at best
+    double ACMR() const { return Triangles ? static_cast<double>(Misses) / Triangles : 0.0; }
+
+    // Average transform to vertex ratio: how often each vertex is transformed, 1 at best
+    double ATVR() const { return Vertices ? static_cast<double>(Misses) / Vertices : 0.0; }
+
+    VertexCacheStatistics &operator+=(const VertexCacheStatistics &other) {
+        Triangles += other.Triangles;
+        Vertices += other.Vertices;
+        Misses += other.Misses;
+        return *this;
+    }
+};
+
+/**
+ * Simulates a FIFO post-transform cache over a triangle list.
+ */
+inline VertexCacheStatistics AnalyzeVertexCache(
+    const std::vector<GLuint> &indices, size_t vertexCount, size_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE
+) {
+    VertexCacheStatistics statistics;
+    statistics.Triangles = indices.size() / 3;
+
+    std::vector<size_t> insertedAt(vertexCount, 0);
+    std::vector<bool> used(vertexCount, false);
+    size_t time = cacheSize + 1;
+
+    for (GLuint index : indices) {
+        if (!used[index]) {
+            used[index] = true;
+            ++statistics.Vertices;
+        }
+
+        if (time - insertedAt[index] > cacheSize) {
+            insertedAt[index] = time++;
+            ++statistics.Misses;
+        }
+    }
+
+    return statistics;
+}
+
+/**
+ * Returns the triangles of `indices` in Tipsify order for a cache of `cacheSize` entries.
+ */
+inline std::vector<GLuint> OptimizeVertexCache(
+    const std::vector<GLuint> &indices, size_t vertexCount, size_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE
+) {
+    const size_t triangleCount = indices.size() / 3;
+
+    // Vertex to triangle adjacency, packed as offsets into one array
+    std::vector<size_t> liveTriangles(vertexCount, 0);
+
+    for (GLuint index : indices) {
+        ++liveTriangles[index];
+    }
+
+    std::vector<size_t> adjacencyOffsets(vertexCount + 1, 0);
+
+    for (size_t v = 0; v < vertexCount; ++v) {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+    }
+
+    std::vector<size_t> adjacency(adjacencyOffsets[vertexCount]);
+    std::vector<size_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+    for (size_t t = 0; t < triangleCount; ++t) {
+        for (size_t corner = 0; corner < 3; ++corner) {
+            adjacency[fill[indices[t * 3 + corner]]++] = t;
+        }
+    }
+
+    std::vector<size_t> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<GLuint> deadEnds;
+    std::vector<GLuint> candidates;
+    std::vector<GLuint> output;
+    output.reserve(triangleCount * 3);
+
+    size_t time = cacheSize + 1;
+    size_t cursor = 0;
+    int64_t fanning = vertexCount ? 0 : -1;
+
+    auto skipDeadEnd = [&]() -> int64_t {
+        while (!deadEnds.empty()) {
+            const GLuint vertex = deadEnds.back();
+            deadEnds.pop_back();
+
+            if (liveTriangles[vertex] > 0) {
+                return vertex;
+            }
+        }
+
+        for (; cursor < vertexCount; ++cursor) {
+            if (liveTriangles[cursor] > 0) {
+                return static_cast<int64_t>(cursor);
+            }
+        }
+
+        return -1;
+    };
+
+    while (fanning >= 0) {
+        candidates.clear();
+
+        for (size_t a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; ++a) {
+            const size_t triangle = adjacency[a];
+
+            if (emitted[triangle]) {
+                continue;
+            }
+
+            for (size_t corner = 0; corner < 3; ++corner) {
+                const GLuint vertex = indices[triangle * 3 + corner];
+
+                output.push_back(vertex);
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                --liveTriangles[vertex];
+
+                if (time - cacheTime[vertex] > cacheSize) {
+                    cacheTime[vertex] = time++;
+                }
+            }
+
+            emitted[triangle] = true;
+        }
+
+        // Prefer the candidate that has been in the cache longest while still fitting all its remaining triangles
+        int64_t next = -1;
+        int64_t bestPriority = -1;
+
+        for (GLuint vertex : candidates) {
+            if (liveTriangles[vertex] == 0) {
+                continue;
+            }
+
+            int64_t priority = 0;
+
+            if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize) {
+                priority = static_cast<int64_t>(time - cacheTime[vertex]);
+            }
+
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                next = vertex;
+            }
+        }
+
+        fanning = next >= 0 ? next : skipDeadEnd();
+    }
+
+    return output;
+}
+
+/**
+ * Renumbers vertices in order of first use and drops any no triangle references. Rewrites `indices` in place.
+ */
+template <typename VertexType>
+std::vector<VertexType> OptimizeVertexFetch(const std::vector<VertexType> &vertices, std::vector<GLuint> &indices) {
+    constexpr GLuint UNASSIGNED = ~GLuint(0);
+
+    std::vector<GLuint> remap(vertices.size(), UNASSIGNED);
+    std::vector<VertexType> reordered;
+    reordered.reserve(vertices.size());
+
+    for (GLuint &index : indices) {
+        if (remap[index] == UNASSIGNED) {
+            remap[index] = static_cast<GLuint>(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+
+        index = remap[index];
+    }
+
+    return reordered;
+}
+} // namespace Geometry
+
+#endif
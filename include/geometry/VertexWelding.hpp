@@ -0,0 +1,147 @@
+/**
+ * @file Merges duplicate vertices of a triangle list and remaps its indices.
+ *
+ * Exporters often write one vertex per triangle corner, so an indexed mesh can carry several copies of every vertex.
+ * Welding keeps the first copy of each and points every index at it, which shrinks the vertex buffer and lets the
+ * post-transform cache see shared vertices as shared.
+ */
+
+#ifndef GEOMETRY_VERTEX_WELDING_H
+#define GEOMETRY_VERTEX_WELDING_H
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+#include "vertex.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Geometry {
+// Floats in a vertex: position, normal, texture coordinates, tangent and bitangent
+constexpr size_t VERTEX_COMPONENTS = sizeof(Vertex) / sizeof(float);
+
+static_assert(sizeof(Vertex) == VERTEX_COMPONENTS * sizeof(float), "vertex must be tightly packed floats");
+
+template<typename Key>
+struct ByteKeyHash {
+    size_t operator()(const Key &key) const {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(key.data());
+        uint64_t hash = 14695981039346656037ull;
+
+        for (size_t i = 0; i < sizeof(Key); ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+
+        return static_cast<size_t>(hash);
+    }
+};
+
+/**
+ * Maps each vertex to the first vertex whose leading `KeyBytes` bytes match, so the simplifier sees through meshes
+ * that were exported with one vertex per triangle corner.
+ */
+template<size_t KeyBytes>
+std::pmr::vector<GLuint> WeldPrefix(
+    const std::vector<Vertex> &vertices, std::pmr::memory_resource *memory = std::pmr::get_default_resource()
+) {
+    static_assert(KeyBytes <= sizeof(Vertex), "key must lie within the vertex");
+
+    using Key = std::array<unsigned char, KeyBytes>;
+
+    std::pmr::unordered_map<Key, GLuint, ByteKeyHash<Key>> first(memory);
+    first.reserve(vertices.size());
+
+    std::pmr::vector<GLuint> remap(vertices.size(), memory);
+
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        Key key;
+        std::memcpy(key.data(), &vertices[i], KeyBytes);
+        remap[i] = first.try_emplace(key, static_cast<GLuint>(i)).first->second;
+    }
+
+    return remap;
+}
+
+/**
+ * Maps each vertex to the first vertex that lands in the same cell of a grid `tolerance` wide in every component.
+ * Vertices closer than `tolerance` merge unless a cell boundary falls between them.
+ */
+inline std::pmr::vector<GLuint> WeldWithTolerance(
+    const std::vector<Vertex> &vertices,
+    float tolerance,
+    std::pmr::memory_resource *memory = std::pmr::get_default_resource()
+) {
+    using Key = std::array<int64_t, VERTEX_COMPONENTS>;
+
+    std::pmr::unordered_map<Key, GLuint, ByteKeyHash<Key>> first(memory);
+    first.reserve(vertices.size());
+
+    std::pmr::vector<GLuint> remap(vertices.size(), memory);
+
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        float components[VERTEX_COMPONENTS];
+        std::memcpy(components, &vertices[i], sizeof(Vertex));
+
+        Key key;
+
+        for (size_t component = 0; component < VERTEX_COMPONENTS; ++component) {
+            key[component] = static_cast<int64_t>(std::floor(components[component] / tolerance));
+        }
+
+        remap[i] = first.try_emplace(key, static_cast<GLuint>(i)).first->second;
+    }
+
+    return remap;
+}
+
+/**
+ * Scratch memory `WeldVertices` takes for `vertexCount` vertices: two remap tables plus one hash node, sized for the
+ * larger tolerance key, and up to two buckets per vertex.
+ */
+inline size_t WeldScratchBytes(size_t vertexCount) {
+    constexpr size_t NODE_BYTES =
+        VERTEX_COMPONENTS * sizeof(int64_t) + sizeof(GLuint) + 2 * sizeof(size_t) + alignof(std::max_align_t);
+    return vertexCount * (2 * sizeof(GLuint) + NODE_BYTES + 2 * sizeof(void *));
+}
+
+/**
+ * Removes duplicate vertices and rewrites `indices` to match, keeping the first vertex of every duplicate set in its
+ * original order. A `tolerance` of zero only merges bit-identical vertices; above zero, every attribute is compared
+ * on a grid of that size. Scratch tables come from `memory`. Returns the number of vertices removed.
+ */
+inline size_t WeldVertices(
+    std::vector<Vertex> &vertices,
+    std::vector<GLuint> &indices,
+    float tolerance = 0.0f,
+    std::pmr::memory_resource *memory = std::pmr::get_default_resource()
+) {
+    const std::pmr::vector<GLuint> remap = tolerance > 0.0f ? WeldWithTolerance(vertices, tolerance, memory)
+                                                            : WeldPrefix<sizeof(Vertex)>(vertices, memory);
+
+    std::pmr::vector<GLuint> compacted(vertices.size(), memory);
+    size_t kept = 0;
+
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        if (remap[i] == i) {
+            compacted[i] = static_cast<GLuint>(kept);
+            vertices[kept++] = vertices[i];
+        }
+    }
+
+    for (GLuint &index : indices) {
+        index = compacted[remap[index]];
+    }
+
+    const size_t removed = vertices.size() - kept;
+    vertices.erase(vertices.begin() + kept, vertices.end());
+    return removed;
+}
+} // namespace Geometry
+
+#endif
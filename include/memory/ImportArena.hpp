@@ -0,0 +1,77 @@
+/**
+ * @file Monotonic scratch memory for converting one mesh at import.
+ *
+ * The import stages build hash maps and remap tables that only live until the mesh is converted. Routing them
+ * through an arena turns thousands of heap allocations into a few large blocks, all returned in one go when the
+ * arena is destroyed. Both sides are counted so the import report can show the difference.
+ */
+
+#ifndef MEMORY_IMPORT_ARENA_H
+#define MEMORY_IMPORT_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory_resource>
+
+namespace Memory {
+/**
+ * Forwards to another resource, counting the allocations that pass through.
+ */
+class CountingResource : public std::pmr::memory_resource {
+private:
+    std::pmr::memory_resource *_upstream;
+    size_t _allocations = 0;
+    size_t _bytes = 0;
+
+    void *do_allocate(size_t bytes, size_t alignment) override {
+        ++_allocations;
+        _bytes += bytes;
+        return _upstream->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *pointer, size_t bytes, size_t alignment) override {
+        _upstream->deallocate(pointer, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+public:
+    explicit CountingResource(std::pmr::memory_resource *upstream) : _upstream(upstream) {}
+
+    size_t Allocations() const { return _allocations; }
+
+    size_t Bytes() const { return _bytes; }
+};
+
+/**
+ * A monotonic buffer that starts out `initialBytes` large, so a well-sized arena takes a single block from the heap.
+ * Not thread-safe; give each worker's mesh its own.
+ */
+class ImportArena {
+private:
+    CountingResource _system;
+    std::pmr::monotonic_buffer_resource _arena;
+    CountingResource _requests;
+
+public:
+    explicit ImportArena(size_t initialBytes) :
+        _system(std::pmr::new_delete_resource()),
+        _arena(std::max<size_t>(initialBytes, 1), &_system),
+        _requests(&_arena) {}
+
+    ImportArena(const ImportArena &) = delete;
+    ImportArena &operator=(const ImportArena &) = delete;
+
+    std::pmr::memory_resource *Resource() { return &_requests; }
+
+    // Allocations made by the import stages
+    size_t Allocations() const { return _requests.Allocations(); }
+
+    // Blocks the arena took from the heap to serve them
+    size_t SystemAllocations() const { return _system.Allocations(); }
+
+    size_t SystemBytes() const { return _system.Bytes(); }
+};
+} // namespace Memory
+
+#endif
@@ -1,100 +1,441 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include <algorithm>
+#include <cstdint>
+#include <utility>
 #include <vector>
 
+#include <glm/glm.hpp>
+
+#include "buffers/GeometryArena.hpp"
+#include "buffers/IndexData.hpp"
+#include "buffers/VertexFormat.hpp"
+#include "cache/Hash.hpp"
+#include "geometry/Bounds.hpp"
+#include "geometry/Lod.hpp"
+#include "geometry/Meshlets.hpp"
+#include "packedVertex.hpp"
+#include "render/IndirectCommand.hpp"
+#include "render/RenderQueue.hpp"
+#include "render/StateCache.hpp"
 #include "shader.hpp"
+#include "shading/ShaderFeatures.hpp"
 #include "texture.hpp"
 #include "vertex.hpp"
 
 #include "openGLCommon.hpp"
 
+/**
+ * What a mesh keeps in system memory once its geometry is on the GPU.
+ */
+enum class CpuRetention {
+    // Nothing; the GPU copy is the only one
+    Drop,
+    // Float vertices and indices, as uploaded
+    Keep,
+    // Vertices in the 20 byte packed layout and narrowed indices, decoded on demand by `CpuVertices`
+    Compressed,
+};
+
 class Mesh {
 private:
-    GLuint VAO, VBO, EBO;
+    Buffers::GeometryAllocation allocation;
+    GLenum indexType;
+    std::vector<Geometry::MeshLod> lods;
+    std::vector<Geometry::Meshlet> meshlets;
+    Geometry::BoundingSphere bounds;
+    PositionQuantization quantization;
 
-    void setupMesh() {
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+    // Per-mesh vertex decoding, set on every draw since meshes sharing a material still differ here
+    void bindGeometry(Shader &shader) const {
+        const StandardUniforms &uniforms = shader.Standard();
+        const bool packed = allocation.Arena()->Format() == Buffers::VertexFormat::Packed;
+        shader.setBool(uniforms.PackedVertices, packed);
+
+        if (packed) {
+            shader.setVec3(uniforms.PositionOffset, quantization.Offset);
+            shader.setVec3(uniforms.PositionScale, quantization.Scale);
+        }
+    }
 
-        glBindVertexArray(VAO);
+    void drawLod(size_t lod) const {
+        const Geometry::MeshLod &range = lods[std::min(lod, lods.size() - 1)];
+        glDrawElementsBaseVertex(
+            GL_TRIANGLES,
+            static_cast<GLsizei>(range.IndexCount),
+            indexType,
+            (void *)(allocation.IndexOffset() + range.IndexOffset * Buffers::IndexSize(indexType)),
+            allocation.BaseVertex()
+        );
+    }
 
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, Vertices.size() * sizeof(Vertex), &Vertices[0], GL_STATIC_DRAW);
+    void drawRanges(const Geometry::DrawRanges &ranges) const {
+        glMultiDrawElementsBaseVertex(
+            GL_TRIANGLES,
+            ranges.Counts.data(),
+            indexType,
+            ranges.Offsets.data(),
+            static_cast<GLsizei>(ranges.Counts.size()),
+            ranges.BaseVertices.data()
+        );
+    }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, Indices.size() * sizeof(GLuint), &Indices[0], GL_STATIC_DRAW);
+    static void bindPacketMaterial(const Render::DrawPacket &packet, Shader &shader) {
+        static_cast<const Mesh *>(packet.Source)->BindMaterial(shader);
+    }
 
-        // Vertex positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
+    static bool sharesPacketMaterial(const Render::DrawPacket &packet, const Render::DrawPacket &other) {
+        return static_cast<const Mesh *>(packet.Source)->SharesMaterial(*static_cast<const Mesh *>(other.Source));
+    }
 
-        // Vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Normal));
+    static void drawPacket(const Render::DrawPacket &packet, Shader &shader, const Render::RenderQueue &queue) {
+        const Mesh &mesh = *static_cast<const Mesh *>(packet.Source);
+        mesh.bindGeometry(shader);
 
-        // Vertex Texture Coordinates
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, TextureCoordinates));
+        if (packet.Ranges == Render::NO_RANGES) {
+            mesh.drawLod(packet.Argument);
+        } else {
+            mesh.drawRanges(queue.Ranges(packet.Ranges));
+        }
+    }
 
-        // Vertex Tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Tangent));
+    size_t indexCount() const { return allocation.IndexBytes() / Buffers::IndexSize(indexType); }
 
-        // Vertex BitTangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, BitTangent));
+    /**
+     * Uploads the mesh and keeps whatever CPU-side index and packed vertex data `retention` asks for. Float vertices
+     * are left to the constructors, which can move them in rather than copy.
+     */
+    void setupMesh(
+        const Vertex *vertices,
+        size_t numVertices,
+        const GLuint *indices,
+        size_t numIndices,
+        Buffers::GeometryArena *arena,
+        CpuRetention retention
+    ) {
+        if (lods.empty()) {
+            lods.push_back({0, static_cast<uint32_t>(numIndices), 0.0f});
+        }
+
+        bounds = Geometry::ComputeBoundingSphere(vertices, numVertices);
+
+        if (!arena) {
+            arena = &Buffers::GeometryArena::Shared(Buffers::VertexFormat::Full);
+        }
+
+        // 32-bit indices can go straight from the caller's memory when no copy is kept
+        Buffers::IndexData narrowed;
+
+        if (indexType == GL_UNSIGNED_SHORT || retention != CpuRetention::Drop) {
+            narrowed = Buffers::IndexData(indices, numIndices, numVertices);
+        }
+
+        const void *indexData = narrowed.Count() ? narrowed.Data() : static_cast<const void *>(indices);
+        const size_t indexBytes = numIndices * Buffers::IndexSize(indexType);
+        const bool packed = arena->Format() == Buffers::VertexFormat::Packed;
+
+        std::vector<PackedVertex> packedVertices;
+
+        if (packed || retention == CpuRetention::Compressed) {
+            packedVertices = PackVertices(vertices, numVertices, quantization);
+        }
 
-        glBindVertexArray(0);
+        if (packed) {
+            allocation = arena->Allocate(packedVertices.data(), packedVertices.size(), indexData, indexBytes);
+        } else {
+            allocation = arena->Allocate(vertices, numVertices, indexData, indexBytes);
+        }
+
+        if (retention != CpuRetention::Drop) {
+            Indices = std::move(narrowed);
+        }
+
+        if (retention == CpuRetention::Compressed) {
+            CompressedVertices = std::move(packedVertices);
+        }
     }
 
 public:
+    // Filled when the mesh keeps full float vertices
     std::vector<Vertex> Vertices;
-    std::vector<GLuint> Indices;
+    // Filled when the mesh keeps its vertices compressed; see `CpuVertices`
+    std::vector<PackedVertex> CompressedVertices;
+    // Narrowed to 16 bits when the mesh has few enough vertices; empty when CPU-side data is dropped
+    Buffers::IndexData Indices;
     std::vector<Texture> Textures;
     GLfloat Shininess;
 
-    Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, std::vector<Texture> textures, float shininess) :
-        Vertices(vertices), Indices(indices), Textures(textures), Shininess(shininess) {
-        setupMesh();
+    /**
+     * Moves the vertices through to the upload, so a mesh built from temporaries never copies them. They are kept in
+     * `Vertices` only when `retention` is `Keep`.
+     */
+    Mesh(
+        std::vector<Vertex> vertices,
+        std::vector<GLuint> indices,
+        std::vector<Texture> textures,
+        float shininess,
+        std::vector<Geometry::MeshLod> meshLods = {},
+        std::vector<Geometry::Meshlet> clusters = {},
+        Buffers::GeometryArena *arena = nullptr,
+        CpuRetention retention = CpuRetention::Keep
+    ) :
+        indexType(Buffers::IndexTypeFor(vertices.size())),
+        lods(std::move(meshLods)),
+        meshlets(std::move(clusters)),
+        Textures(std::move(textures)),
+        Shininess(shininess) {
+        setupMesh(vertices.data(), vertices.size(), indices.data(), indices.size(), arena, retention);
+
+        if (retention == CpuRetention::Keep) {
+            Vertices = std::move(vertices);
+        }
+    }
+
+    /**
+     * Uploads directly from caller-owned memory, such as a mapped model cache. Vertices are packed on the way in when
+     * `arena` uses the packed format; a null arena means the shared float one.
+     */
+    Mesh(
+        const Vertex *vertices,
+        size_t numVertices,
+        const GLuint *indices,
+        size_t numIndices,
+        std::vector<Texture> textures,
+        float shininess,
+        std::vector<Geometry::MeshLod> meshLods = {},
+        std::vector<Geometry::Meshlet> clusters = {},
+        Buffers::GeometryArena *arena = nullptr,
+        CpuRetention retention = CpuRetention::Drop
+    ) :
+        indexType(Buffers::IndexTypeFor(numVertices)),
+        lods(std::move(meshLods)),
+        meshlets(std::move(clusters)),
+        Textures(std::move(textures)),
+        Shininess(shininess) {
+        setupMesh(vertices, numVertices, indices, numIndices, arena, retention);
+
+        if (retention == CpuRetention::Keep) {
+            Vertices.assign(vertices, vertices + numVertices);
+        }
     }
 
-    void Draw(Shader &shader) const {
+    Mesh(const Mesh &) = delete;
+    Mesh &operator=(const Mesh &) = delete;
+    Mesh(Mesh &&) = default;
+    Mesh &operator=(Mesh &&) = default;
+
+    GLenum IndexType() const { return indexType; }
+
+    // Decodes positions when the mesh lives in a packed arena
+    const PositionQuantization &Quantization() const { return quantization; }
+
+    // Binds the textures to units from zero up and sets the shininess
+    void BindMaterial(Shader &shader) const {
         unsigned int diffuseNr = 0;
         unsigned int specularNr = 0;
         unsigned int normalNr = 0;
 
+        Render::StateCache &state = Render::StateCache::Shared();
+
         for (unsigned int i = 0; i < Textures.size(); ++i) {
-            glActiveTexture(GL_TEXTURE0 + i);
-
-            std::string number;
-            std::string name = Textures[i].Type;
-
-            if (name == "texture_diffuse") {
-                name += std::to_string(diffuseNr);
-                ++diffuseNr;
-            } else if (name == "texture_specular") {
-                name += std::to_string(specularNr);
-                ++specularNr;
-            } else if (name == "texture_normal") {
-                name += std::to_string(normalNr);
-                ++normalNr;
+            const std::string &type = Textures[i].Type;
+            unsigned int number = 0;
+
+            if (type == "texture_diffuse") {
+                number = diffuseNr++;
+            } else if (type == "texture_specular") {
+                number = specularNr++;
+            } else if (type == "texture_normal") {
+                number = normalNr++;
             }
 
-            shader.setInt("material." + name, i);
+            shader.setInt(shader.MaterialSampler(type, number), i);
+            state.BindTexture(i, Textures[i].ID);
+        }
+
+        shader.setFloat(shader.Standard().Shininess, Shininess);
+    }
+
+    // The shader features this mesh's textures need; the cheapest permutation that can draw it
+    uint32_t MaterialFeatures() const {
+        uint32_t features = 0;
+
+        for (const Texture &texture : Textures) {
+            features |= Shading::TextureFeature(texture.Type);
+        }
+
+        return features;
+    }
 
-            glBindTexture(GL_TEXTURE_2D, Textures[i].ID);
+    // The vertices as floats, decoded when kept compressed and empty when dropped
+    std::vector<Vertex> CpuVertices() const {
+        if (!CompressedVertices.empty()) {
+            return UnpackVertices(CompressedVertices.data(), CompressedVertices.size(), quantization);
         }
 
-        shader.setFloat("material.shininess", Shininess);
+        return Vertices;
+    }
+
+    // System memory held by the retained vertices and indices
+    size_t CpuBytes() const {
+        return Vertices.size() * sizeof(Vertex) + CompressedVertices.size() * sizeof(PackedVertex) + Indices.Bytes();
+    }
+
+    // System memory of full float vertices and 32-bit indices, the baseline the retention savings are measured from
+    size_t FullCopyBytes() const {
+        return allocation.VertexCount() * sizeof(Vertex) + indexCount() * sizeof(GLuint);
+    }
+
+    // Video memory taken from the arena
+    size_t GpuBytes() const {
+        return allocation.VertexCount() * Buffers::VertexStride(Arena().Format()) + allocation.IndexBytes();
+    }
+
+    // The arena holding this mesh, whose vertex array must be bound before drawing
+    Buffers::GeometryArena &Arena() const { return *allocation.Arena(); }
+
+    size_t LodCount() const { return lods.size(); }
+
+    const Geometry::BoundingSphere &Bounds() const { return bounds; }
 
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, Indices.size(), GL_UNSIGNED_INT, 0);
+    /**
+     * Picks the coarsest LOD whose error stays under `maxPixelError` pixels when drawn with `model` from
+     * `cameraPosition`. Distance is measured to the bounding sphere, so a camera inside it always gets full detail.
+     */
+    size_t SelectLod(
+        const glm::mat4 &model, const glm::vec3 &cameraPosition, float projectionScale, float maxPixelError
+    ) const {
+        const float scale = Geometry::MaxScale(model);
+        const glm::vec3 center = glm::vec3(model * glm::vec4(bounds.Center, 1.0f));
+        const float distance = glm::length(center - cameraPosition) - bounds.Radius * scale;
+
+        if (distance <= 0.0f) {
+            return 0;
+        }
+
+        return Geometry::SelectLod(lods, scale, distance, projectionScale, maxPixelError);
+    }
+
+    // Clusters of the full-detail LOD, empty when meshlets weren't built
+    const std::vector<Geometry::Meshlet> &Meshlets() const { return meshlets; }
+
+    /**
+     * Draws one LOD. Expects `Arena()`'s vertex array to be bound, so a model binds it once for all its meshes.
+     */
+    void Draw(Shader &shader, size_t lod = 0) const {
+        BindMaterial(shader);
+        bindGeometry(shader);
+        drawLod(lod);
+    }
+
+    // Starts a set of draw ranges over this mesh's index buffer
+    void BeginRanges(Geometry::DrawRanges &ranges) const {
+        ranges.Begin(allocation.IndexOffset(), Buffers::IndexSize(indexType), allocation.BaseVertex());
+    }
+
+    /**
+     * Draws only the given index ranges, typically the meshlets that survived culling, in one call. Expects
+     * `Arena()`'s vertex array to be bound.
+     */
+    void Draw(Shader &shader, const Geometry::DrawRanges &ranges) const {
+        if (ranges.Counts.empty()) {
+            return;
+        }
+
+        BindMaterial(shader);
+        bindGeometry(shader);
+        drawRanges(ranges);
+    }
+
+    /**
+     * Appends the indirect commands that draw `lod` or, when given, only the index `ranges` that survived culling.
+     * Each carries `drawIndex` as its base instance, for the vertex shader to find the draw's data with.
+     */
+    void AppendCommands(
+        std::vector<Render::DrawElementsIndirectCommand> &commands,
+        uint32_t drawIndex,
+        size_t lod,
+        const Geometry::DrawRanges *ranges = nullptr
+    ) const {
+        const size_t indexSize = Buffers::IndexSize(indexType);
+
+        if (!ranges) {
+            const Geometry::MeshLod &range = lods[std::min(lod, lods.size() - 1)];
+            const GLuint firstIndex = static_cast<GLuint>(allocation.IndexOffset() / indexSize) + range.IndexOffset;
+            commands.push_back({range.IndexCount, 1, firstIndex, allocation.BaseVertex(), drawIndex});
+            return;
+        }
+
+        for (size_t i = 0; i < ranges->Counts.size(); ++i) {
+            const size_t byteOffset = reinterpret_cast<size_t>(ranges->Offsets[i]);
+            commands.push_back(
+                {static_cast<GLuint>(ranges->Counts[i]),
+                 1,
+                 static_cast<GLuint>(byteOffset / indexSize),
+                 ranges->BaseVertices[i],
+                 drawIndex}
+            );
+        }
+    }
+
+    // Identifies the textures and shininess, so meshes that share them sort together and bind them once
+    uint64_t MaterialKey() const {
+        uint64_t key = Cache::FNV_OFFSET_BASIS;
+
+        for (const Texture &texture : Textures) {
+            key = Cache::HashBytes(reinterpret_cast<const unsigned char *>(&texture.ID), sizeof(texture.ID), key);
+        }
+
+        return Cache::HashBytes(reinterpret_cast<const unsigned char *>(&Shininess), sizeof(Shininess), key);
+    }
+
+    // Whether `other` binds exactly what this mesh does; equal `MaterialKey`s can still collide
+    bool SharesMaterial(const Mesh &other) const {
+        if (Shininess != other.Shininess || Textures.size() != other.Textures.size()) {
+            return false;
+        }
+
+        for (size_t i = 0; i < Textures.size(); ++i) {
+            if (Textures[i].ID != other.Textures[i].ID || Textures[i].Type != other.Textures[i].Type) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * Queues the mesh for `queue` to draw with `shader` and the matrices of `object`, at `lod` or, when given, only
+     * the index `ranges` that survived culling.
+     */
+    void Submit(
+        Render::RenderQueue &queue,
+        Shader &shader,
+        uint32_t object,
+        float depth,
+        size_t lod,
+        const Geometry::DrawRanges *ranges = nullptr,
+        Render::RenderPass pass = Render::RenderPass::Opaque
+    ) const {
+        if (ranges && ranges->Counts.empty()) {
+            return;
+        }
 
-        glBindVertexArray(0);
-        glActiveTexture(GL_TEXTURE0);
+        Render::DrawPacket packet;
+        packet.Pass = pass;
+        packet.Program = &shader;
+        packet.Material = MaterialKey();
+        packet.VertexArray = allocation.Arena()->VertexArray();
+        packet.Depth = depth;
+        packet.Object = object;
+        packet.Source = this;
+        packet.Argument = static_cast<uint32_t>(lod);
+        packet.Ranges = ranges ? queue.AddRanges(*ranges) : Render::NO_RANGES;
+        packet.BindMaterial = bindPacketMaterial;
+        packet.SharesMaterial = sharesPacketMaterial;
+        packet.Draw = drawPacket;
+        queue.Add(packet);
     }
 };
 
@@ -0,0 +1,27 @@
+#ifndef MESH_DATA_H
+#define MESH_DATA_H
+
+#include <vector>
+
+#include "geometry/Lod.hpp"
+#include "geometry/Meshlets.hpp"
+#include "texture.hpp"
+#include "vertex.hpp"
+
+#include "openGLCommon.hpp"
+
+/**
+ * CPU-side result of converting one imported mesh, before anything touches the GL context.
+ */
+struct MeshData {
+    std::vector<Vertex> Vertices;
+    std::vector<GLuint> Indices;
+    // Ranges of `Indices`, finest first; empty when LODs weren't generated
+    std::vector<Geometry::MeshLod> Lods;
+    // Clusters of the full-detail range of `Indices`; empty when meshlets weren't built
+    std::vector<Geometry::Meshlet> Meshlets;
+    std::vector<TextureReference> Textures;
+    GLfloat Shininess = 0.0f;
+};
+
+#endif
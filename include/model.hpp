@@ -2,110 +2,519 @@
 #define MODEL_H
 
 #include "assimp/vector3.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <assimp/DefaultIOSystem.h>
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-
 #include "assimp/material.h"
 #include "assimp/mesh.h"
+#include "buffers/GeometryArena.hpp"
+#include "buffers/IndexData.hpp"
+#include "cache/ModelCache.hpp"
+#include "camera/Camera.hpp"
+#include "geometry/Frustum.hpp"
+#include "geometry/Lod.hpp"
+#include "geometry/MeshSplitting.hpp"
+#include "geometry/Meshlets.hpp"
+#include "geometry/VertexCacheOptimizer.hpp"
+#include "geometry/VertexWelding.hpp"
+#include "memory/ImportArena.hpp"
 #include "mesh.hpp"
+#include "meshData.hpp"
+#include "render/MultiDrawBatch.hpp"
+#include "render/RenderQueue.hpp"
+#include "packedVertex.hpp"
 #include "shader.hpp"
+#include "shading/ShaderVariants.hpp"
 #include "texture.hpp"
+#include "textures/AsyncTextureLoader.hpp"
+#include "textures/Image.hpp"
+#include "textures/TextureCache.hpp"
+#include "threading/ThreadPool.hpp"
 
 #include "openGLCommon.hpp"
 
 namespace Model {
-struct StbiImageDeleter {
-    void operator()(unsigned char *data) { stbi_image_free(data); }
-};
+struct LoadOptions {
+    // Convert sub-meshes on the shared thread pool instead of one at a time on the context thread
+    bool ParallelImport = true;
 
-GLuint loadTexture(char const *path) {
-    GLuint textureId;
-    glGenTextures(1, &textureId);
+    // Merge duplicate vertices before any other stage, and report how much each mesh shrank
+    bool WeldVertices = false;
 
-    GLint width, height, nrComponents;
+    // Zero only merges bit-identical vertices; otherwise every attribute is compared on a grid this fine
+    float WeldTolerance = 0.0f;
 
-    stbi_set_flip_vertically_on_load(true);
-    std::unique_ptr<unsigned char, StbiImageDeleter> data(stbi_load(path, &width, &height, &nrComponents, 0));
+    // When set, textures are decoded in the background and start out as placeholders; otherwise they load inline
+    Textures::AsyncTextureLoader *TextureLoader = nullptr;
 
-    if (!data.get()) {
-        std::cout << "Failed to load texture" << std::endl;
-        return textureId;
-    }
+    // Shared with every other model using the same cache, so common material maps are only loaded once
+    Textures::TextureCache *TextureCache = &Textures::TextureCache::Shared();
+
+    // Reorder triangles and vertices for the post-transform cache and fetch locality, and report ACMR/ATVR
+    bool OptimizeVertexCache = false;
+
+    // Simplify each mesh into coarser LODs sharing its vertex buffer, for Draw to pick from by screen-space error
+    bool GenerateLods = false;
+
+    // Split each mesh into meshlets with bounding spheres and normal cones, for Draw to cull on the CPU
+    bool BuildMeshlets = false;
 
-    GLenum format;
+    // Upload vertices in the 20 byte quantised layout instead of full floats
+    bool PackVertices = false;
 
-    switch (nrComponents) {
-    case 1:
-        format = GL_RED;
-        break;
-    case 3:
-        format = GL_RGB;
-        break;
-    case 4:
-        format = GL_RGBA;
-        break;
+    // Split meshes with more vertices than 16-bit indices can address, so every part uses 16-bit indices
+    bool SplitLargeMeshes = false;
+
+    // What each mesh keeps in system memory after upload, for CPU-side queries such as picking
+    CpuRetention Retention = CpuRetention::Keep;
+};
+
+/**
+ * Per-mesh figures gathered by the optional import stages, summed over the model for reporting.
+ */
+struct ImportStatistics {
+    std::string Name;
+    size_t VerticesBeforeWeld = 0;
+    size_t VerticesAfterWeld = 0;
+    Geometry::VertexCacheStatistics CacheBefore;
+    Geometry::VertexCacheStatistics CacheAfter;
+    std::array<size_t, Geometry::MAX_MESH_LODS> LodTriangles = {};
+    size_t Meshlets = 0;
+    size_t VertexBytes = 0;
+    size_t PackedVertexBytes = 0;
+    size_t IndexBytes = 0;
+    size_t NarrowIndexBytes = 0;
+    size_t SplitMeshes = 0;
+    size_t ScratchAllocations = 0;
+    size_t ScratchSystemAllocations = 0;
+    size_t ScratchBytes = 0;
+
+    ImportStatistics &operator+=(const ImportStatistics &other) {
+        VerticesBeforeWeld += other.VerticesBeforeWeld;
+        VerticesAfterWeld += other.VerticesAfterWeld;
+        CacheBefore += other.CacheBefore;
+        CacheAfter += other.CacheAfter;
+
+        for (size_t level = 0; level < LodTriangles.size(); ++level) {
+            LodTriangles[level] += other.LodTriangles[level];
+        }
+
+        Meshlets += other.Meshlets;
+        VertexBytes += other.VertexBytes;
+        PackedVertexBytes += other.PackedVertexBytes;
+        IndexBytes += other.IndexBytes;
+        NarrowIndexBytes += other.NarrowIndexBytes;
+        SplitMeshes += other.SplitMeshes;
+        ScratchAllocations += other.ScratchAllocations;
+        ScratchSystemAllocations += other.ScratchSystemAllocations;
+        ScratchBytes += other.ScratchBytes;
+
+        return *this;
     }
+};
 
-    glBindTexture(GL_TEXTURE_2D, textureId);
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data.get());
-    glGenerateMipmap(GL_TEXTURE_2D);
+/**
+ * Reads through the default file system while remembering every file opened, so the files an importer pulls in
+ * besides the model itself, such as an OBJ's material library, can be tracked by the cache.
+ */
+class RecordingIOSystem : public Assimp::DefaultIOSystem {
+private:
+    std::vector<std::string> _opened;
+
+public:
+    Assimp::IOStream *Open(const char *file, const char *mode = "rb") override {
+        Assimp::IOStream *stream = Assimp::DefaultIOSystem::Open(file, mode);
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        if (stream && std::find(_opened.begin(), _opened.end(), file) == _opened.end()) {
+            _opened.emplace_back(file);
+        }
+
+        return stream;
+    }
 
-    return textureId;
+    const std::vector<std::string> &Opened() const { return _opened; }
 };
 
 class Model {
 private:
+    static constexpr unsigned int IMPORT_FLAGS =
+        aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace | aiProcess_GenSmoothNormals;
+
+    // Bits recorded in the model cache for the optional stages that ran after Assimp
+    static constexpr uint32_t STAGE_VERTEX_CACHE = 1 << 0;
+    static constexpr uint32_t STAGE_LODS = 1 << 1;
+    static constexpr uint32_t STAGE_MESHLETS = 1 << 2;
+    static constexpr uint32_t STAGE_SPLIT = 1 << 3;
+    static constexpr uint32_t STAGE_WELD = 1 << 4;
+
     std::vector<Mesh> meshes;
-    std::vector<Texture> loadedTextures;
+    std::vector<GLuint> acquiredTextures;
     std::string directory;
+    LoadOptions options;
+    Buffers::GeometryArena *arena;
+    Geometry::DrawRanges visibleRanges;
+    Geometry::CullStatistics cullStatistics;
 
     void loadModel(std::string path) {
+        directory = path.substr(0, path.find_last_of('/'));
+
+        const std::string cachePath = Cache::ModelCachePath(path);
+        const uint64_t sourceHash = Cache::HashFile(path);
+
+        if (loadFromCache(cachePath, sourceHash)) {
+            return;
+        }
+
         Assimp::Importer import;
+        // Owned by the importer, which deletes it with itself
+        RecordingIOSystem *files = new RecordingIOSystem();
+        import.SetIOHandler(files);
 
-        const aiScene *scene = import.ReadFile(
-            path,
-            aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace | aiProcess_GenSmoothNormals
-        );
+        const aiScene *scene = import.ReadFile(path, IMPORT_FLAGS);
 
         if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
             std::cout << "ERROR::ASSIMP::" << import.GetErrorString() << "\n";
             return;
         }
 
-        directory = path.substr(0, path.find_last_of('/'));
+        std::vector<const aiMesh *> workItems;
+        processNode(scene->mRootNode, scene, workItems);
+
+        std::vector<std::vector<MeshData>> parts(workItems.size());
+        std::vector<ImportStatistics> statistics(workItems.size());
+
+        auto convert = [&](size_t i) {
+            // Scratch tables for this mesh only, freed together as soon as it is converted
+            Memory::ImportArena scratch(scratchBytes(workItems[i]->mNumVertices));
+
+            MeshData data = processMesh(workItems[i], scene);
+            statistics[i].Name = workItems[i]->mName.C_Str();
+
+            weldMesh(data, statistics[i], scratch.Resource());
+            parts[i] = splitMesh(std::move(data), statistics[i], scratch.Resource());
+
+            for (MeshData &part : parts[i]) {
+                runImportStages(part, statistics[i]);
+            }
+
+            statistics[i].ScratchAllocations = scratch.Allocations();
+            statistics[i].ScratchSystemAllocations = scratch.SystemAllocations();
+            statistics[i].ScratchBytes = scratch.SystemBytes();
+        };
+
+        if (options.ParallelImport) {
+            Threading::ThreadPool::Shared().ParallelFor(workItems.size(), convert);
+        } else {
+            for (size_t i = 0; i < workItems.size(); ++i) {
+                convert(i);
+            }
+        }
+
+        reportImportStatistics(path, statistics);
+
+        std::vector<MeshData> meshData;
+
+        for (std::vector<MeshData> &meshParts : parts) {
+            std::move(meshParts.begin(), meshParts.end(), std::back_inserter(meshData));
+        }
+
+        std::vector<std::string> dependencies;
+
+        for (const std::string &file : files->Opened()) {
+            if (file != path) {
+                dependencies.push_back(file);
+            }
+        }
+
+        Cache::WriteModelCache(
+            cachePath, sourceHash, IMPORT_FLAGS, stageFlags(), stageParameters(), dependencies, meshData
+        );
+
+        meshes.reserve(meshData.size());
+
+        size_t vertexCount = 0;
+        size_t indexBytes = 0;
+
+        for (const MeshData &data : meshData) {
+            vertexCount += data.Vertices.size();
+            indexBytes += data.Indices.size() * Buffers::IndexSize(Buffers::IndexTypeFor(data.Vertices.size()));
+        }
+
+        arena->Reserve(vertexCount, indexBytes);
+
+        for (MeshData &data : meshData) {
+            meshes.emplace_back(
+                std::move(data.Vertices),
+                std::move(data.Indices),
+                resolveTextures(data.Textures),
+                data.Shininess,
+                std::move(data.Lods),
+                std::move(data.Meshlets),
+                arena,
+                options.Retention
+            );
+        }
+    }
+
+    uint32_t stageFlags() const {
+        return (options.OptimizeVertexCache ? STAGE_VERTEX_CACHE : 0) | (options.GenerateLods ? STAGE_LODS : 0) |
+               (options.BuildMeshlets ? STAGE_MESHLETS : 0) | (options.SplitLargeMeshes ? STAGE_SPLIT : 0) |
+               (options.WeldVertices ? STAGE_WELD : 0);
+    }
+
+    uint32_t stageParameters() const {
+        uint32_t tolerance = 0;
+
+        if (options.WeldVertices) {
+            std::memcpy(&tolerance, &options.WeldTolerance, sizeof(tolerance));
+        }
+
+        return tolerance;
+    }
+
+    // Sized from Assimp's vertex count so the enabled stages fit in the arena's first block
+    size_t scratchBytes(size_t vertexCount) const {
+        size_t bytes = 0;
+
+        if (options.WeldVertices) {
+            bytes += Geometry::WeldScratchBytes(vertexCount);
+        }
+
+        if (options.SplitLargeMeshes && vertexCount > Buffers::MAX_SHORT_INDEX_VERTICES) {
+            bytes += Geometry::SplitScratchBytes(vertexCount, Buffers::MAX_SHORT_INDEX_VERTICES);
+        }
+
+        return bytes;
+    }
+
+    void weldMesh(MeshData &data, ImportStatistics &statistics, std::pmr::memory_resource *scratch) const {
+        if (!options.WeldVertices) {
+            return;
+        }
+
+        statistics.VerticesBeforeWeld += data.Vertices.size();
+        Geometry::WeldVertices(data.Vertices, data.Indices, options.WeldTolerance, scratch);
+        statistics.VerticesAfterWeld += data.Vertices.size();
+    }
+
+    /**
+     * Returns `data` as the parts it has to be drawn in: itself, or pieces small enough for 16-bit indices.
+     */
+    std::vector<MeshData>
+    splitMesh(MeshData data, ImportStatistics &statistics, std::pmr::memory_resource *scratch) const {
+        std::vector<MeshData> parts;
+
+        if (!options.SplitLargeMeshes || data.Vertices.size() <= Buffers::MAX_SHORT_INDEX_VERTICES) {
+            parts.push_back(std::move(data));
+            return parts;
+        }
+
+        for (Geometry::MeshPart &part :
+             Geometry::SplitByVertexCount(data.Vertices, data.Indices, Buffers::MAX_SHORT_INDEX_VERTICES, scratch)) {
+            MeshData &piece = parts.emplace_back();
+            piece.Vertices = std::move(part.Vertices);
+            piece.Indices = std::move(part.Indices);
+            piece.Textures = data.Textures;
+            piece.Shininess = data.Shininess;
+        }
+
+        ++statistics.SplitMeshes;
+        return parts;
+    }
+
+    /**
+     * Optional CPU passes over a converted mesh, adding to `statistics`. Runs on the same worker thread as
+     * `processMesh`.
+     */
+    void runImportStages(MeshData &data, ImportStatistics &statistics) const {
+        if (options.OptimizeVertexCache) {
+            statistics.CacheBefore += Geometry::AnalyzeVertexCache(data.Indices, data.Vertices.size());
+            data.Indices = Geometry::OptimizeVertexCache(data.Indices, data.Vertices.size());
+            data.Vertices = Geometry::OptimizeVertexFetch(data.Vertices, data.Indices);
+            statistics.CacheAfter += Geometry::AnalyzeVertexCache(data.Indices, data.Vertices.size());
+        }
+
+        if (options.BuildMeshlets) {
+            data.Meshlets = Geometry::BuildMeshlets(data.Vertices, data.Indices, data.Indices.size());
+            statistics.Meshlets += data.Meshlets.size();
+        }
+
+        if (options.GenerateLods) {
+            std::vector<Geometry::SimplifiedIndices> levels = Geometry::GenerateLods(data.Vertices, data.Indices);
+
+            data.Lods.push_back({0, static_cast<uint32_t>(data.Indices.size()), 0.0f});
+
+            for (Geometry::SimplifiedIndices &level : levels) {
+                if (options.OptimizeVertexCache) {
+                    level.Indices = Geometry::OptimizeVertexCache(level.Indices, data.Vertices.size());
+                }
+
+                const uint32_t offset = static_cast<uint32_t>(data.Indices.size());
 
-        processNode(scene->mRootNode, scene);
+                data.Lods.push_back({offset, static_cast<uint32_t>(level.Indices.size()), level.Error});
+                data.Indices.insert(data.Indices.end(), level.Indices.begin(), level.Indices.end());
+            }
+
+            for (size_t level = 0; level < data.Lods.size(); ++level) {
+                statistics.LodTriangles[level] += data.Lods[level].IndexCount / 3;
+            }
+        }
+
+        statistics.VertexBytes += data.Vertices.size() * sizeof(Vertex);
+        statistics.PackedVertexBytes += data.Vertices.size() * sizeof(PackedVertex);
+        statistics.IndexBytes += data.Indices.size() * sizeof(GLuint);
+        statistics.NarrowIndexBytes +=
+            data.Indices.size() * Buffers::IndexSize(Buffers::IndexTypeFor(data.Vertices.size()));
     }
 
-    void processNode(aiNode *node, const aiScene *scene) {
+    void reportImportStatistics(const std::string &path, const std::vector<ImportStatistics> &statistics) const {
+        ImportStatistics total;
+
+        for (const ImportStatistics &mesh : statistics) {
+            total += mesh;
+        }
+
+        if (options.WeldVertices) {
+            std::cout << "Vertex welding: " << path << "\n";
+
+            for (size_t i = 0; i < statistics.size(); ++i) {
+                std::cout << i << " " << statistics[i].Name << ": " << statistics[i].VerticesBeforeWeld << " -> "
+                          << statistics[i].VerticesAfterWeld << "\n";
+            }
+
+            std::cout << "total: " << total.VerticesBeforeWeld << " -> " << total.VerticesAfterWeld << std::endl;
+        }
+
+        if (options.OptimizeVertexCache) {
+            std::cout << "Vertex cache optimization: " << path << "\nACMR: " << total.CacheBefore.ACMR() << " -> "
+                      << total.CacheAfter.ACMR() << "\nATVR: " << total.CacheBefore.ATVR() << " -> "
+                      << total.CacheAfter.ATVR() << std::endl;
+        }
+
+        if (options.GenerateLods) {
+            std::cout << "LOD triangles: " << path << "\n";
+
+            for (size_t level = 0; level < total.LodTriangles.size(); ++level) {
+                std::cout << (level ? " / " : "") << total.LodTriangles[level];
+            }
+
+            std::cout << std::endl;
+        }
+
+        if (options.BuildMeshlets) {
+            std::cout << "Meshlets: " << path << "\n" << total.Meshlets << std::endl;
+        }
+
+        if (options.PackVertices) {
+            std::cout << "Vertex buffers: " << path << "\n"
+                      << total.VertexBytes << " -> " << total.PackedVertexBytes << " bytes" << std::endl;
+        }
+
+        if (options.WeldVertices || options.SplitLargeMeshes) {
+            std::cout << "Import scratch: " << path << "\n"
+                      << total.ScratchAllocations << " allocations from " << total.ScratchSystemAllocations
+                      << " heap blocks, " << total.ScratchBytes << " bytes" << std::endl;
+        }
+
+        std::cout << "Index buffers: " << path << "\n"
+                  << total.IndexBytes << " -> " << total.NarrowIndexBytes << " bytes";
+
+        if (options.SplitLargeMeshes) {
+            std::cout << ", " << total.SplitMeshes << " meshes split";
+        }
+
+        std::cout << std::endl;
+    }
+
+    void reportMemory(const std::string &path) const {
+        size_t cpuBytes = 0;
+        size_t fullCopyBytes = 0;
+        size_t gpuBytes = 0;
+
+        for (const Mesh &mesh : meshes) {
+            cpuBytes += mesh.CpuBytes();
+            fullCopyBytes += mesh.FullCopyBytes();
+            gpuBytes += mesh.GpuBytes();
+        }
+
+        std::cout << "Mesh memory: " << path << "\nCPU: " << cpuBytes << " bytes retained of " << fullCopyBytes
+                  << "\nGPU: " << gpuBytes << " bytes" << std::endl;
+    }
+
+    bool loadFromCache(const std::string &cachePath, uint64_t sourceHash) {
+        Cache::ModelCacheReader cache(cachePath, sourceHash, IMPORT_FLAGS, stageFlags(), stageParameters());
+
+        if (!cache.IsValid()) {
+            return false;
+        }
+
+        meshes.reserve(cache.Meshes().size());
+
+        size_t vertexCount = 0;
+        size_t indexBytes = 0;
+
+        for (const Cache::CachedMesh &mesh : cache.Meshes()) {
+            vertexCount += mesh.VertexCount;
+            indexBytes += mesh.IndexCount * Buffers::IndexSize(Buffers::IndexTypeFor(mesh.VertexCount));
+        }
+
+        arena->Reserve(vertexCount, indexBytes);
+
+        for (const Cache::CachedMesh &mesh : cache.Meshes()) {
+            meshes.emplace_back(
+                mesh.Vertices,
+                mesh.VertexCount,
+                mesh.Indices,
+                mesh.IndexCount,
+                resolveTextures(mesh.Textures),
+                mesh.Shininess,
+                mesh.Lods,
+                mesh.Meshlets,
+                arena,
+                options.Retention
+            );
+        }
+
+        return true;
+    }
+
+    /**
+     * Gathers the meshes referenced by the node tree in draw order, so they can be converted independently.
+     */
+    void processNode(const aiNode *node, const aiScene *scene, std::vector<const aiMesh *> &workItems) {
         for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
-            aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-            processMesh(mesh, scene);
+            workItems.push_back(scene->mMeshes[node->mMeshes[i]]);
         }
 
         for (unsigned int i = 0; i < node->mNumChildren; ++i) {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, workItems);
         }
     }
 
-    void processMesh(aiMesh *mesh, const aiScene *scene) {
-        std::vector<Vertex> vertices;
-        std::vector<GLuint> indices;
-        std::vector<Texture> textures;
-        GLfloat shininess = 0.0f;
+    /**
+     * Converts one Assimp mesh into CPU-side data. Only reads the scene, so it is safe to run on worker threads.
+     */
+    MeshData processMesh(const aiMesh *mesh, const aiScene *scene) const {
+        MeshData data;
+        std::vector<Vertex> &vertices = data.Vertices;
+        std::vector<GLuint> &indices = data.Indices;
+        std::vector<TextureReference> &textures = data.Textures;
+
+        // Triangulated faces have exactly three indices, so both arrays are sized once
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve(static_cast<size_t>(mesh->mNumFaces) * 3);
 
         for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
             aiVector3D aiVertex = mesh->mVertices[i];
@@ -134,7 +543,7 @@ private:
         }
 
         for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
-            aiFace face = mesh->mFaces[i];
+            const aiFace &face = mesh->mFaces[i];
 
             for (unsigned int j = 0; j < face.mNumIndices; j++) {
                 indices.push_back(face.mIndices[j]);
@@ -142,55 +551,229 @@ private:
         }
 
         if (mesh->mMaterialIndex >= 0) {
-            aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
+            const aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
 
-            std::vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-            std::vector<Texture> specularMaps =
-                loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-            std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_NORMALS, "texture_normal");
+            textures.reserve(
+                material->GetTextureCount(aiTextureType_DIFFUSE) + material->GetTextureCount(aiTextureType_SPECULAR) +
+                material->GetTextureCount(aiTextureType_NORMALS)
+            );
 
-            textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-            textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-            textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+            loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", textures);
+            loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", textures);
+            loadMaterialTextures(material, aiTextureType_NORMALS, "texture_normal", textures);
 
-            material->Get(AI_MATKEY_SHININESS, shininess);
+            material->Get(AI_MATKEY_SHININESS, data.Shininess);
         }
 
-        meshes.emplace_back(vertices, indices, textures, shininess);
+        return data;
     }
 
-    std::vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName) {
-        std::vector<Texture> textures;
-
+    void loadMaterialTextures(
+        const aiMaterial *mat, aiTextureType type, const char *typeName, std::vector<TextureReference> &textures
+    ) const {
         for (unsigned int i = 0; i < mat->GetTextureCount(type); ++i) {
             aiString str;
             mat->GetTexture(type, i, &str);
-            std::string path = directory + "/" + str.C_Str();
-
-            auto matchingTexture =
-                std::find_if(loadedTextures.begin(), loadedTextures.end(), [path](const Texture &loadedTexture) {
-                    return path.compare(loadedTexture.Path) == 0;
-                });
-
-            if (matchingTexture != loadedTextures.end()) {
-                textures.push_back(*matchingTexture);
-            } else {
-                loadedTextures.emplace_back(loadTexture(path.c_str()), typeName, path);
-                textures.push_back(loadedTextures[loadedTextures.size() - 1]);
-            }
+            textures.emplace_back(typeName, str.C_Str());
+        }
+    }
+
+    std::vector<Texture> resolveTextures(const std::vector<TextureReference> &references) {
+        std::vector<Texture> textures;
+
+        for (const TextureReference &reference : references) {
+            std::string path = directory + "/" + reference.Path;
+            GLuint textureId = options.TextureCache->Acquire(path, reference.Type, options.TextureLoader);
+
+            acquiredTextures.push_back(textureId);
+            textures.emplace_back(textureId, reference.Type, path);
         }
 
         return textures;
     }
 
+    /**
+     * Culls and picks LODs for the camera `Draw`s and `Submit`, calling `visit(mesh, lod, ranges)` for each
+     * mesh that is at least partly visible. `ranges` holds the meshlets that survived culling, or is null when the
+     * whole LOD is drawn; it is only valid until the next call.
+     */
+    template<typename Visit>
+    void forEachVisible(
+        Visit &&visit,
+        const Camera &camera,
+        const glm::mat4 &projection,
+        const glm::mat4 &model,
+        float viewportHeight,
+        float maxPixelError
+    ) {
+        const float projectionScale = Geometry::ProjectionScale(camera.Zoom(), viewportHeight);
+        const glm::vec3 cameraPosition = camera.Position();
+        const Geometry::Frustum frustum = Geometry::Frustum::FromMatrix(projection * camera.GetViewMatrix());
+        const float scale = Geometry::MaxScale(model);
+
+        cullStatistics = Geometry::CullStatistics();
+        arena->Bind();
+
+        for (const Mesh &mesh : meshes) {
+            const glm::vec3 center = glm::vec3(model * glm::vec4(mesh.Bounds().Center, 1.0f));
+
+            if (!frustum.IntersectsSphere(center, mesh.Bounds().Radius * scale)) {
+                continue;
+            }
+
+            const size_t lod = mesh.SelectLod(model, cameraPosition, projectionScale, maxPixelError);
+
+            if (lod > 0 || mesh.Meshlets().empty()) {
+                visit(mesh, lod, nullptr);
+                continue;
+            }
+
+            mesh.BeginRanges(visibleRanges);
+            cullStatistics += Geometry::CullMeshlets(mesh.Meshlets(), model, frustum, cameraPosition, visibleRanges);
+            visit(mesh, lod, &visibleRanges);
+        }
+    }
+
 public:
-    Model(const char *path) { loadModel(path); }
+    Model(const char *path, LoadOptions loadOptions = LoadOptions()) :
+        options(loadOptions),
+        arena(&Buffers::GeometryArena::Shared(
+            loadOptions.PackVertices ? Buffers::VertexFormat::Packed : Buffers::VertexFormat::Full
+        )) {
+        loadModel(path);
+        reportMemory(path);
+    }
+
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+    Model(Model &&) = default;
+
+    ~Model() {
+        for (GLuint textureId : acquiredTextures) {
+            options.TextureCache->Release(textureId);
+        }
+    }
 
     void Draw(Shader &shader) {
+        arena->Bind();
+
         for (const Mesh &mesh : meshes) {
             mesh.Draw(shader);
         }
     }
+
+    /**
+     * Draws each mesh at the coarsest LOD whose error covers at most `maxPixelError` pixels of a viewport
+     * `viewportHeight` pixels tall, seen through `camera` and `projection` with the model matrix `model`.
+     *
+     * Meshes outside the view frustum are skipped. At full detail, meshes with meshlets only draw the clusters that
+     * pass the frustum and back-facing cone tests.
+     */
+    void Draw(
+        Shader &shader,
+        const Camera &camera,
+        const glm::mat4 &projection,
+        const glm::mat4 &model,
+        float viewportHeight,
+        float maxPixelError = Geometry::DEFAULT_LOD_PIXEL_ERROR
+    ) {
+        const auto draw = [&shader](const Mesh &mesh, size_t lod, const Geometry::DrawRanges *ranges) {
+            ranges ? mesh.Draw(shader, *ranges) : mesh.Draw(shader, lod);
+        };
+
+        forEachVisible(draw, camera, projection, model, viewportHeight, maxPixelError);
+    }
+
+    /**
+     * Like the single shader `Draw`, but each mesh uses the cheapest permutation in `variants` for its textures,
+     * combined with the `sceneFeatures` shared by the whole frame such as the point light count. The model and normal
+     * matrices are set on each permutation as it comes into use.
+     */
+    void Draw(
+        Shading::ShaderVariants &variants,
+        uint32_t sceneFeatures,
+        const Camera &camera,
+        const glm::mat4 &projection,
+        const glm::mat4 &model,
+        float viewportHeight,
+        float maxPixelError = Geometry::DEFAULT_LOD_PIXEL_ERROR
+    ) {
+        const glm::mat3 rotation = glm::transpose(glm::inverse(glm::mat3(model)));
+        Shader *current = nullptr;
+
+        const auto shaderFor = [&](const Mesh &mesh) -> Shader & {
+            Shader &shader = variants.Get(sceneFeatures | mesh.MaterialFeatures());
+
+            if (&shader != current) {
+                current = &shader;
+                shader.use();
+                shader.setMat4(shader.Standard().Model, model);
+                shader.setMat3(shader.Standard().Rotation, rotation);
+            }
+
+            return shader;
+        };
+
+        const auto draw = [&](const Mesh &mesh, size_t lod, const Geometry::DrawRanges *ranges) {
+            ranges ? mesh.Draw(shaderFor(mesh), *ranges) : mesh.Draw(shaderFor(mesh), lod);
+        };
+
+        forEachVisible(draw, camera, projection, model, viewportHeight, maxPixelError);
+    }
+
+    /**
+     * Culls and picks LODs like the camera `Draw`s, but queues the visible meshes on `queue` instead of drawing
+     * them, each with the cheapest permutation in `variants` for its textures plus `sceneFeatures`.
+     */
+    void Submit(
+        Render::RenderQueue &queue,
+        Shading::ShaderVariants &variants,
+        uint32_t sceneFeatures,
+        const Camera &camera,
+        const glm::mat4 &projection,
+        const glm::mat4 &model,
+        float viewportHeight,
+        float maxPixelError = Geometry::DEFAULT_LOD_PIXEL_ERROR,
+        Render::RenderPass pass = Render::RenderPass::Opaque
+    ) {
+        const uint32_t object = queue.AddObject(model);
+
+        const auto submit = [&](const Mesh &mesh, size_t lod, const Geometry::DrawRanges *ranges) {
+            const float depth = queue.ViewDepth(glm::vec3(model * glm::vec4(mesh.Bounds().Center, 1.0f)));
+            Shader &shader = variants.Get(sceneFeatures | mesh.MaterialFeatures());
+            mesh.Submit(queue, shader, object, depth, lod, ranges, pass);
+        };
+
+        forEachVisible(submit, camera, projection, model, viewportHeight, maxPixelError);
+    }
+
+    /**
+     * Culls and picks LODs like `Submit`, but adds the visible meshes to `batch`, which draws every mesh sharing a
+     * program and material in one multi-draw call. Call once per instance to draw many copies of the model, each
+     * with its own `model` matrix; the permutations used also have `Shading::FEATURE_MULTI_DRAW` set.
+     */
+    void Submit(
+        Render::MultiDrawBatch &batch,
+        Shading::ShaderVariants &variants,
+        uint32_t sceneFeatures,
+        const Camera &camera,
+        const glm::mat4 &projection,
+        const glm::mat4 &model,
+        float viewportHeight,
+        float maxPixelError = Geometry::DEFAULT_LOD_PIXEL_ERROR
+    ) {
+        const uint32_t object = batch.AddObject(model);
+
+        const auto add = [&](const Mesh &mesh, size_t lod, const Geometry::DrawRanges *ranges) {
+            Shader &shader = variants.Get(sceneFeatures | Shading::FEATURE_MULTI_DRAW | mesh.MaterialFeatures());
+            batch.Add(mesh, shader, object, lod, ranges);
+        };
+
+        forEachVisible(add, camera, projection, model, viewportHeight, maxPixelError);
+    }
+
+    // Meshlet culling results of the last camera Draw
+    const Geometry::CullStatistics &LastCullStatistics() const { return cullStatistics; }
 };
 } // namespace Model
 
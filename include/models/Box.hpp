@@ -1,8 +1,17 @@
 #ifndef BOX_H
 #define BOX_H
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
 #include <glm/glm.hpp>
 
+#include "buffers/FrameRingBuffer.hpp"
+#include "buffers/StreamBuffer.hpp"
+#include "render/RenderQueue.hpp"
+#include "render/StateCache.hpp"
 #include "shader.hpp"
 
 #include "openGLCommon.hpp"
@@ -35,18 +44,109 @@ class Box {
         -0.5f, 0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f, -0.5f, 0.5f,  -0.5f, 0.0f,  1.0f,  0.0f,  0.0f, 1.0f
     };
 
+    // Instance attributes follow the position, normal and texture coordinates; the matrix takes four locations
+    static constexpr GLuint INSTANCE_MODEL_LOCATION = 3;
+    static constexpr GLuint INSTANCE_COLOR_LOCATION = 7;
+    static constexpr size_t MIN_INSTANCE_CAPACITY = 64;
+    static constexpr size_t INSTANCE_BYTES = sizeof(glm::mat4) + sizeof(glm::vec3);
+
     inline static GLuint boxCoordinatesVAO;
     inline static GLuint boxCoordinatesVBO;
+    // Transforms for `instanceCapacity()` instances, followed by their colors
+    inline static GLuint instanceVBO;
+    inline static size_t instanceBytes = 0;
+
+    // Instances queued by `Submit`, uploaded together by the first of their packets to be drawn
+    inline static std::vector<glm::mat4> stagedTransforms;
+    inline static std::vector<glm::vec3> stagedColors;
+    // Whether a packet has drawn from the staging, so the next `Submit` starts a new frame's batch
+    inline static bool stagedDrawn = false;
+    // Whether `instanceVBO` holds the staging; `Draw` overwrites it with its own instances
+    inline static bool stagedResident = false;
+
+    static size_t instanceCapacity() { return instanceBytes / INSTANCE_BYTES; }
+
+    static size_t colorOffset() { return instanceCapacity() * sizeof(glm::mat4); }
+
+    static void uploadInstances(const glm::mat4 *transforms, const glm::vec3 *colors, size_t count) {
+        Buffers::OrphanStream(
+            GL_ARRAY_BUFFER, instanceVBO, instanceBytes, count * INSTANCE_BYTES, MIN_INSTANCE_CAPACITY * INSTANCE_BYTES
+        );
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), transforms);
+        glBufferSubData(GL_ARRAY_BUFFER, colorOffset(), count * sizeof(glm::vec3), colors);
+    }
+
+    // Points the instance attributes at transforms from `transformStart` and colors from `colorStart` in `buffer`
+    static void bindInstances(GLuint buffer, size_t transformStart, size_t colorStart) {
+        Render::StateCache &state = Render::StateCache::Shared();
+        state.BindVertexArray(boxCoordinatesVAO);
+        state.BindBuffer(GL_ARRAY_BUFFER, buffer);
+
+        for (GLuint column = 0; column < 4; ++column) {
+            const size_t offset = transformStart + column * sizeof(glm::vec4);
+            glVertexAttribPointer(
+                INSTANCE_MODEL_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void *)offset
+            );
+        }
+
+        glVertexAttribPointer(INSTANCE_COLOR_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)colorStart);
+    }
+
+    // The uploaded instances from `first` on
+    static void bindInstances(size_t first) {
+        bindInstances(instanceVBO, first * sizeof(glm::mat4), colorOffset() + first * sizeof(glm::vec3));
+    }
+
+    static void drawPacket(const Render::DrawPacket &packet, Shader &, const Render::RenderQueue &) {
+        if (!stagedResident) {
+            uploadInstances(stagedTransforms.data(), stagedColors.data(), stagedTransforms.size());
+            stagedResident = true;
+        }
+
+        stagedDrawn = true;
+
+        bindInstances(packet.Argument);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 36, static_cast<GLsizei>(packet.InstanceCount));
+    }
+
+    // Draws instances written to a ring buffer, `Argument` bytes into it with the colors after the transforms
+    static void drawRingPacket(const Render::DrawPacket &packet, Shader &, const Render::RenderQueue &) {
+        const GLuint buffer = static_cast<const Buffers::FrameRingBuffer *>(packet.Source)->Buffer();
+        const size_t transformStart = packet.Argument;
+        bindInstances(buffer, transformStart, transformStart + packet.InstanceCount * sizeof(glm::mat4));
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 36, static_cast<GLsizei>(packet.InstanceCount));
+    }
+
+    // One packet for `count` instances, sorted by the nearest box so early depth testing still helps what it can
+    static Render::DrawPacket
+    instancePacket(Render::RenderQueue &queue, Shader &shader, const glm::mat4 *transforms, size_t count) {
+        float depth = queue.ViewDepth(glm::vec3(transforms[0][3]));
+
+        for (size_t i = 1; i < count; ++i) {
+            depth = std::min(depth, queue.ViewDepth(glm::vec3(transforms[i][3])));
+        }
+
+        Render::DrawPacket packet;
+        packet.Program = &shader;
+        packet.VertexArray = boxCoordinatesVAO;
+        packet.Depth = depth;
+        packet.Object = queue.AddObject(glm::mat4(1.0f));
+        packet.InstanceCount = static_cast<uint32_t>(count);
+        return packet;
+    }
 
 public:
     static void Init() {
+        Render::StateCache &state = Render::StateCache::Shared();
+
         glGenVertexArrays(1, &boxCoordinatesVAO);
         glGenBuffers(1, &boxCoordinatesVBO);
+        glGenBuffers(1, &instanceVBO);
 
-        glBindBuffer(GL_ARRAY_BUFFER, boxCoordinatesVBO);
+        state.BindBuffer(GL_ARRAY_BUFFER, boxCoordinatesVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-        glBindVertexArray(boxCoordinatesVAO);
+        state.BindVertexArray(boxCoordinatesVAO);
 
         // position attribute
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void *)0);
@@ -60,32 +160,104 @@ public:
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void *)(6 * sizeof(GLfloat)));
         glEnableVertexAttribArray(2);
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        // instance attributes, advancing once per box; their pointers are set when instances are drawn
+        for (GLuint location = INSTANCE_MODEL_LOCATION; location <= INSTANCE_COLOR_LOCATION; ++location) {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
     }
 
-    // TODO refactor so that we can draw multiple boxes at once
-    static void Draw(Shader &shader, glm::mat4 model, glm::mat4 view, glm::mat4 projection) {
-        glBindVertexArray(boxCoordinatesVAO);
+    /**
+     * Draws `count` boxes in one call, the i-th with the model matrix `transforms[i]` in the flat `colors[i]`. Expects
+     * a shader that reads both as instance attributes, such as `instancedModelViewProjection.vert`.
+     */
+    static void Draw(Shader &shader, const glm::mat4 *transforms, const glm::vec3 *colors, size_t count) {
+        if (count == 0) {
+            return;
+        }
 
-        glm::mat3 rotation = glm::transpose(glm::inverse(glm::mat3(model)));
+        uploadInstances(transforms, colors, count);
+        stagedResident = false;
 
         shader.use();
-        shader.setMat4("model", model);
-        shader.setMat4("view", view);
-        shader.setMat4("projection", projection);
-        shader.setMat3("rotation", rotation);
+        bindInstances(0);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 36, static_cast<GLsizei>(count));
+    }
+
+    /**
+     * Queues `count` boxes as a single instanced packet. The instances are copied, so the arrays need not outlive the
+     * call; they are uploaded once, with every other batch submitted before the queue runs.
+     */
+    static void Submit(
+        Render::RenderQueue &queue, Shader &shader, const glm::mat4 *transforms, const glm::vec3 *colors, size_t count
+    ) {
+        if (count == 0) {
+            return;
+        }
+
+        // The previous frame's instances have been drawn, so this starts the next batch
+        if (stagedDrawn) {
+            stagedTransforms.clear();
+            stagedColors.clear();
+            stagedDrawn = false;
+            stagedResident = false;
+        }
+
+        const size_t first = stagedTransforms.size();
+        stagedTransforms.insert(stagedTransforms.end(), transforms, transforms + count);
+        stagedColors.insert(stagedColors.end(), colors, colors + count);
+
+        Render::DrawPacket packet = instancePacket(queue, shader, transforms, count);
+        packet.Argument = static_cast<uint32_t>(first);
+        packet.Draw = drawPacket;
+        queue.Add(packet);
+    }
+
+    /**
+     * Like `Submit`, but writes the instances straight into this frame's part of `ring` rather than staging them for
+     * an upload. Falls back to staging when the ring is full.
+     */
+    static void Submit(
+        Render::RenderQueue &queue,
+        Buffers::FrameRingBuffer &ring,
+        Shader &shader,
+        const glm::mat4 *transforms,
+        const glm::vec3 *colors,
+        size_t count
+    ) {
+        if (count == 0) {
+            return;
+        }
+
+        const size_t transformBytes = count * sizeof(glm::mat4);
+        const Buffers::RingAllocation instances = ring.Allocate(transformBytes + count * sizeof(glm::vec3));
+
+        if (!instances.Pointer) {
+            Submit(queue, shader, transforms, colors, count);
+            return;
+        }
 
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        unsigned char *destination = static_cast<unsigned char *>(instances.Pointer);
+        std::memcpy(destination, transforms, transformBytes);
+        std::memcpy(destination + transformBytes, colors, count * sizeof(glm::vec3));
 
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        Render::DrawPacket packet = instancePacket(queue, shader, transforms, count);
+        packet.Source = &ring;
+        packet.Argument = static_cast<uint32_t>(instances.Offset);
+        packet.Draw = drawRingPacket;
+        queue.Add(packet);
     }
 
     static void Deinit() {
+        Render::StateCache &state = Render::StateCache::Shared();
+        state.ForgetVertexArray(boxCoordinatesVAO);
+        state.ForgetBuffer(boxCoordinatesVBO);
+        state.ForgetBuffer(instanceVBO);
         glDeleteVertexArrays(1, &boxCoordinatesVAO);
         glDeleteBuffers(1, &boxCoordinatesVBO);
+        glDeleteBuffers(1, &instanceVBO);
+        instanceBytes = 0;
     }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,116 @@
+/**
+ * @file Entry points newer than the GL 3.3 core profile the bundled glad loader is generated for.
+ *
+ * Each feature is loaded through GLFW when the context's version or an extension provides it, and flagged so callers
+ * can fall back when it doesn't. The pointers have their own names so they never collide with glad's macros.
+ */
+
+#ifndef OPEN_GL_EXTENSIONS_H
+#define OPEN_GL_EXTENSIONS_H
+
+#include "openGLCommon.hpp"
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+namespace Extensions {
+using GetProgramBinaryFunction = void(GLAD_API_PTR *)(GLuint, GLsizei, GLsizei *, GLenum *, void *);
+using ProgramBinaryFunction = void(GLAD_API_PTR *)(GLuint, GLenum, const void *, GLsizei);
+using ProgramParameteriFunction = void(GLAD_API_PTR *)(GLuint, GLenum, GLint);
+using MaxShaderCompilerThreadsFunction = void(GLAD_API_PTR *)(GLuint);
+using BufferStorageFunction = void(GLAD_API_PTR *)(GLenum, GLsizeiptr, const void *, GLbitfield);
+using MultiDrawElementsIndirectFunction = void(GLAD_API_PTR *)(GLenum, GLenum, const void *, GLsizei, GLsizei);
+
+// GL 4.1 or ARB_get_program_binary, with at least one binary format
+inline bool ProgramBinarySupported = false;
+inline GetProgramBinaryFunction GetProgramBinary = nullptr;
+inline ProgramBinaryFunction ProgramBinary = nullptr;
+inline ProgramParameteriFunction ProgramParameteri = nullptr;
+
+// KHR or ARB_parallel_shader_compile: compiles and links run on driver threads, polled with GL_COMPLETION_STATUS_KHR
+inline bool ParallelShaderCompileSupported = false;
+inline MaxShaderCompilerThreadsFunction MaxShaderCompilerThreads = nullptr;
+
+// GL 4.3, or ARB_multi_draw_indirect with ARB_base_instance so each command's base instance is honoured
+inline bool MultiDrawIndirectSupported = false;
+inline MultiDrawElementsIndirectFunction MultiDrawElementsIndirect = nullptr;
+
+// GL 4.4 or ARB_buffer_storage: immutable buffers that can stay mapped while the GPU reads them
+inline bool BufferStorageSupported = false;
+inline BufferStorageFunction BufferStorage = nullptr;
+
+inline bool HasVersion(GLint major, GLint minor) {
+    GLint contextMajor = 0;
+    GLint contextMinor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &contextMajor);
+    glGetIntegerv(GL_MINOR_VERSION, &contextMinor);
+    return contextMajor > major || (contextMajor == major && contextMinor >= minor);
+}
+
+template<typename Function>
+bool LoadFunction(Function &function, const char *name) {
+    function = reinterpret_cast<Function>(glfwGetProcAddress(name));
+    return function != nullptr;
+}
+
+/**
+ * Resolves every optional entry point. Call once after `gladLoadGL`, with the context current.
+ */
+inline void Load() {
+    if (HasVersion(4, 1) || glfwExtensionSupported("GL_ARB_get_program_binary")) {
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+        ProgramBinarySupported = LoadFunction(GetProgramBinary, "glGetProgramBinary") &&
+                                 LoadFunction(ProgramBinary, "glProgramBinary") &&
+                                 LoadFunction(ProgramParameteri, "glProgramParameteri") && formats > 0;
+    }
+
+    if (glfwExtensionSupported("GL_KHR_parallel_shader_compile")) {
+        ParallelShaderCompileSupported = LoadFunction(MaxShaderCompilerThreads, "glMaxShaderCompilerThreadsKHR");
+    } else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile")) {
+        ParallelShaderCompileSupported = LoadFunction(MaxShaderCompilerThreads, "glMaxShaderCompilerThreadsARB");
+    }
+
+    if (ParallelShaderCompileSupported) {
+        // As many compiler threads as the driver is willing to use
+        MaxShaderCompilerThreads(0xFFFFFFFFu);
+    }
+
+    if (HasVersion(4, 3) ||
+        (glfwExtensionSupported("GL_ARB_multi_draw_indirect") && glfwExtensionSupported("GL_ARB_base_instance"))) {
+        MultiDrawIndirectSupported = LoadFunction(MultiDrawElementsIndirect, "glMultiDrawElementsIndirect");
+    }
+
+    if (HasVersion(4, 4) || glfwExtensionSupported("GL_ARB_buffer_storage")) {
+        BufferStorageSupported = LoadFunction(BufferStorage, "glBufferStorage");
+    }
+}
+} // namespace Extensions
+
+#endif
@@ -0,0 +1,166 @@
+/**
+ * @file A 20 byte alternative to the 56 byte `Vertex` for GPU vertex buffers.
+ *
+ *   position  4 x unorm16  xyz relative to the mesh's bounding box, w holds the bitangent sign
+ *   uv        2 x half
+ *   normal    2 x snorm16  octahedral
+ *   tangent   2 x snorm16  octahedral
+ *
+ * The bitangent is rebuilt in the vertex shader as `cross(normal, tangent) * sign`.
+ */
+
+#ifndef PACKED_VERTEX_H
+#define PACKED_VERTEX_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "vertex.hpp"
+
+struct PackedVertex {
+    uint16_t Position[4];
+    uint16_t TextureCoordinates[2];
+    int16_t Normal[2];
+    int16_t Tangent[2];
+};
+
+static_assert(sizeof(PackedVertex) == 20, "packed vertices must stay tightly packed");
+
+/**
+ * Maps the unorm16 positions of a mesh back to object space: `position = Offset + packed * Scale`.
+ */
+struct PositionQuantization {
+    glm::vec3 Offset = glm::vec3(0.0f);
+    glm::vec3 Scale = glm::vec3(1.0f);
+};
+
+namespace VertexPacking {
+inline int16_t PackSnorm16(float value) {
+    return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+inline uint16_t PackUnorm16(float value) {
+    return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+/**
+ * Projects a unit vector onto the octahedron and unfolds it into [-1, 1]^2 (Meyer et al., "On Floating-Point Normal
+ * Vectors"). Zero vectors, such as the tangents of meshes without UVs, encode as +Z.
+ */
+inline glm::vec2 OctahedralEncode(const glm::vec3 &vector) {
+    const float sum = std::abs(vector.x) + std::abs(vector.y) + std::abs(vector.z);
+
+    if (sum == 0.0f) {
+        return glm::vec2(0.0f);
+    }
+
+    const glm::vec3 n = vector / sum;
+
+    if (n.z >= 0.0f) {
+        return glm::vec2(n.x, n.y);
+    }
+
+    return glm::vec2(
+        (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f)
+    );
+}
+
+inline glm::vec3 OctahedralDecode(const glm::vec2 &encoded) {
+    glm::vec3 n(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+    const float fold = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -fold : fold;
+    n.y += n.y >= 0.0f ? -fold : fold;
+    return glm::normalize(n);
+}
+} // namespace VertexPacking
+
+/**
+ * Quantises `count` vertices against their bounding box, returning the packed vertices and how to undo the position
+ * quantisation.
+ */
+inline std::vector<PackedVertex>
+PackVertices(const Vertex *vertices, size_t count, PositionQuantization &quantization) {
+    using namespace VertexPacking;
+
+    glm::vec3 minimum(0.0f);
+    glm::vec3 maximum(0.0f);
+
+    if (count > 0) {
+        minimum = maximum = vertices[0].Position;
+    }
+
+    for (size_t i = 1; i < count; ++i) {
+        minimum = glm::min(minimum, vertices[i].Position);
+        maximum = glm::max(maximum, vertices[i].Position);
+    }
+
+    const glm::vec3 extent = maximum - minimum;
+    quantization.Offset = minimum;
+    quantization.Scale = glm::vec3(
+        extent.x > 0.0f ? extent.x : 1.0f, extent.y > 0.0f ? extent.y : 1.0f, extent.z > 0.0f ? extent.z : 1.0f
+    );
+
+    std::vector<PackedVertex> packed(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        const Vertex &vertex = vertices[i];
+        PackedVertex &out = packed[i];
+
+        const glm::vec3 position = (vertex.Position - quantization.Offset) / quantization.Scale;
+        const bool flipped = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.BitTangent) < 0.0f;
+
+        out.Position[0] = PackUnorm16(position.x);
+        out.Position[1] = PackUnorm16(position.y);
+        out.Position[2] = PackUnorm16(position.z);
+        out.Position[3] = flipped ? 0 : 65535;
+
+        out.TextureCoordinates[0] = glm::packHalf1x16(vertex.TextureCoordinates.x);
+        out.TextureCoordinates[1] = glm::packHalf1x16(vertex.TextureCoordinates.y);
+
+        const glm::vec2 normal = OctahedralEncode(vertex.Normal);
+        const glm::vec2 tangent = OctahedralEncode(vertex.Tangent);
+
+        out.Normal[0] = PackSnorm16(normal.x);
+        out.Normal[1] = PackSnorm16(normal.y);
+        out.Tangent[0] = PackSnorm16(tangent.x);
+        out.Tangent[1] = PackSnorm16(tangent.y);
+    }
+
+    return packed;
+}
+
+/**
+ * Decodes vertices packed with `quantization`, rebuilding each bitangent the way the vertex shader does.
+ */
+inline std::vector<Vertex>
+UnpackVertices(const PackedVertex *packed, size_t count, const PositionQuantization &quantization) {
+    using namespace VertexPacking;
+
+    std::vector<Vertex> vertices;
+    vertices.reserve(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        const PackedVertex &in = packed[i];
+
+        const glm::vec3 position =
+            glm::vec3(in.Position[0], in.Position[1], in.Position[2]) / 65535.0f * quantization.Scale +
+            quantization.Offset;
+        const glm::vec2 textureCoordinates(
+            glm::unpackHalf1x16(in.TextureCoordinates[0]), glm::unpackHalf1x16(in.TextureCoordinates[1])
+        );
+        const glm::vec3 normal = OctahedralDecode(glm::vec2(in.Normal[0], in.Normal[1]) / 32767.0f);
+        const glm::vec3 tangent = OctahedralDecode(glm::vec2(in.Tangent[0], in.Tangent[1]) / 32767.0f);
+        const float sign = in.Position[3] == 0 ? -1.0f : 1.0f;
+
+        vertices.emplace_back(position, normal, textureCoordinates, tangent, glm::cross(normal, tangent) * sign);
+    }
+
+    return vertices;
+}
+
+#endif
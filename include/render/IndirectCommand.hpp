@@ -0,0 +1,26 @@
+/**
+ * @file The command record `glMultiDrawElementsIndirect` reads from the bound draw indirect buffer.
+ */
+
+#ifndef RENDER_INDIRECT_COMMAND_H
+#define RENDER_INDIRECT_COMMAND_H
+
+#include "openGLCommon.hpp"
+
+namespace Render {
+/**
+ * One indexed draw. `FirstIndex` counts indices, not bytes, into the bound index buffer. `BaseInstance` offsets the
+ * instanced attributes, which is how a command tells the vertex shader which per-draw data is its own.
+ */
+struct DrawElementsIndirectCommand {
+    GLuint Count = 0;
+    GLuint InstanceCount = 1;
+    GLuint FirstIndex = 0;
+    GLint BaseVertex = 0;
+    GLuint BaseInstance = 0;
+};
+
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "indirect commands are five tightly packed 32-bit values");
+} // namespace Render
+
+#endif
@@ -0,0 +1,414 @@
+/**
+ * @file Sub-meshes drawn as indirect commands, one `glMultiDrawElementsIndirect` per program and material.
+ *
+ * Every mesh in a geometry arena shares its vertex and index buffers, so what used to set uniforms and issue a draw
+ * per mesh becomes a command in one indirect buffer. What the uniforms carried moves into per-draw data, nine RGBA32F
+ * texels per draw in a buffer texture:
+ *
+ *   model (4) | normal matrix (3) | position offset (1) | position scale (1)
+ *
+ * The vertex shader, built with `Shading::FEATURE_MULTI_DRAW`, reads its draw's texels at the index taken from an
+ * instanced attribute holding 0, 1, 2, ... Each command's base instance offsets that attribute, so it reads as the
+ * command's draw index without needing `gl_DrawID`.
+ *
+ * Textures are still bound per material, since GL 3.3 has no bindless handles to put in the per-draw data; meshes
+ * sharing a program and material go out in one call however many models and instances they belong to. Without
+ * multi-draw indirect support the same commands are issued one `glDrawElementsBaseVertex` at a time.
+ *
+ * Given a `Buffers::FrameRingBuffer`, the commands are grouped straight into it instead of into the batch's own
+ * indirect buffer.
+ */
+
+#ifndef RENDER_MULTI_DRAW_BATCH_H
+#define RENDER_MULTI_DRAW_BATCH_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "buffers/FrameRingBuffer.hpp"
+#include "buffers/IndexData.hpp"
+#include "buffers/StreamBuffer.hpp"
+#include "buffers/VertexFormat.hpp"
+#include "geometry/Meshlets.hpp"
+#include "mesh.hpp"
+#include "openGLExtensions.hpp"
+#include "render/IndirectCommand.hpp"
+#include "render/RenderQueue.hpp"
+#include "render/StateCache.hpp"
+#include "shader.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Render {
+// After the vertex formats' locations 0-7
+constexpr GLuint DRAW_INDEX_LOCATION = 8;
+// Vertex shader unit for the per-draw data, clear of the units materials bind from zero up
+constexpr GLuint DRAW_DATA_TEXTURE_UNIT = 15;
+constexpr size_t MIN_DRAW_CAPACITY = 64;
+
+// One draw's texels, matching DRAW_DATA_TEXELS in the vertex shader
+struct DrawData {
+    glm::vec4 Model[4];
+    glm::vec4 Rotation[3];
+    glm::vec4 PositionOffset;
+    glm::vec4 PositionScale;
+};
+
+static_assert(sizeof(DrawData) == 9 * sizeof(glm::vec4), "draw data is nine tightly packed texels");
+
+struct BatchStatistics {
+    // Mesh draws added, each with its own per-draw data
+    size_t Draws = 0;
+    size_t Commands = 0;
+    // Multi-draw calls the commands went out in
+    size_t Batches = 0;
+};
+
+// Collects a frame's mesh draws and queues one packet per program and material
+class MultiDrawBatch {
+private:
+    struct Group {
+        const MultiDrawBatch *Batch = nullptr;
+        Shader *Program = nullptr;
+        // The first mesh added to the group, whose textures are bound for all of it
+        const Mesh *Material = nullptr;
+        uint64_t MaterialKey = 0;
+        GLenum IndexType = GL_UNSIGNED_INT;
+        GLuint VertexArray = 0;
+        bool Packed = false;
+        size_t FirstCommand = 0;
+        size_t CommandCount = 0;
+    };
+
+    GLuint _commandBuffer = 0;
+    // Where this frame's commands were written: the own buffer from zero, or a ring buffer at some offset
+    GLuint _commandSource = 0;
+    size_t _commandBase = 0;
+    GLuint _drawDataBuffer = 0;
+    GLuint _drawDataTexture = 0;
+    // 0, 1, 2, ... read through the instanced draw index attribute
+    GLuint _drawIndexBuffer = 0;
+    size_t _commandCapacity = 0;
+    size_t _drawDataCapacity = 0;
+    size_t _drawIndexCapacity = 0;
+
+    std::vector<RenderObject> _objects;
+    std::vector<DrawData> _draws;
+    std::vector<uint32_t> _drawGroups;
+    std::vector<Group> _groups;
+    // Commands in the order they were added, then grouped for the upload
+    std::vector<DrawElementsIndirectCommand> _added;
+    std::vector<DrawElementsIndirectCommand> _commands;
+    // Arena vertex arrays whose draw index attribute is already set up
+    std::vector<GLuint> _preparedVertexArrays;
+    BatchStatistics _statistics;
+
+    uint32_t groupFor(const Mesh &mesh, Shader &shader) {
+        const uint64_t materialKey = mesh.MaterialKey();
+        const GLenum indexType = mesh.IndexType();
+        const GLuint vertexArray = mesh.Arena().VertexArray();
+
+        for (size_t i = 0; i < _groups.size(); ++i) {
+            const Group &group = _groups[i];
+
+            if (group.Program == &shader && group.MaterialKey == materialKey && group.IndexType == indexType &&
+                group.VertexArray == vertexArray && group.Material->SharesMaterial(mesh)) {
+                return static_cast<uint32_t>(i);
+            }
+        }
+
+        Group &group = _groups.emplace_back();
+        group.Batch = this;
+        group.Program = &shader;
+        group.Material = &mesh;
+        group.MaterialKey = materialKey;
+        group.IndexType = indexType;
+        group.VertexArray = vertexArray;
+        group.Packed = mesh.Arena().Format() == Buffers::VertexFormat::Packed;
+        return static_cast<uint32_t>(_groups.size() - 1);
+    }
+
+    // Fills the draw index buffer up to `count`; it never changes after that, so it is only rewritten to grow
+    void reserveDrawIndices(size_t count) {
+        if (count <= _drawIndexCapacity) {
+            return;
+        }
+
+        _drawIndexCapacity = std::max({count, _drawIndexCapacity * 2, MIN_DRAW_CAPACITY});
+        std::vector<GLuint> indices(_drawIndexCapacity);
+
+        for (size_t i = 0; i < indices.size(); ++i) {
+            indices[i] = static_cast<GLuint>(i);
+        }
+
+        StateCache::Shared().BindBuffer(GL_ARRAY_BUFFER, _drawIndexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    }
+
+    // Adds the instanced draw index attribute to an arena's vertex array, once
+    void prepareVertexArray(GLuint vertexArray) {
+        if (std::find(_preparedVertexArrays.begin(), _preparedVertexArrays.end(), vertexArray) !=
+            _preparedVertexArrays.end()) {
+            return;
+        }
+
+        StateCache &state = StateCache::Shared();
+        state.BindVertexArray(vertexArray);
+        state.BindBuffer(GL_ARRAY_BUFFER, _drawIndexBuffer);
+        glVertexAttribIPointer(DRAW_INDEX_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void *)0);
+        glVertexAttribDivisor(DRAW_INDEX_LOCATION, 1);
+        glEnableVertexAttribArray(DRAW_INDEX_LOCATION);
+
+        _preparedVertexArrays.push_back(vertexArray);
+    }
+
+    // Writes the added commands to `destination` ordered by group, so each group's commands are contiguous
+    void groupCommands(DrawElementsIndirectCommand *destination) {
+        for (Group &group : _groups) {
+            group.CommandCount = 0;
+        }
+
+        for (const DrawElementsIndirectCommand &command : _added) {
+            ++_groups[_drawGroups[command.BaseInstance]].CommandCount;
+        }
+
+        size_t first = 0;
+
+        for (Group &group : _groups) {
+            group.FirstCommand = first;
+            first += group.CommandCount;
+            group.CommandCount = 0;
+        }
+
+        for (const DrawElementsIndirectCommand &command : _added) {
+            Group &group = _groups[_drawGroups[command.BaseInstance]];
+            destination[group.FirstCommand + group.CommandCount++] = command;
+        }
+    }
+
+    void drawGroup(const Group &group, Shader &shader) const {
+        StateCache &state = StateCache::Shared();
+        const StandardUniforms &uniforms = shader.Standard();
+
+        shader.setBool(uniforms.PackedVertices, group.Packed);
+        shader.setInt(uniforms.DrawData, DRAW_DATA_TEXTURE_UNIT);
+
+        state.ActiveTexture(DRAW_DATA_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, _drawDataTexture);
+
+        if (Extensions::MultiDrawIndirectSupported) {
+            state.BindBuffer(GL_DRAW_INDIRECT_BUFFER, _commandSource);
+            Extensions::MultiDrawElementsIndirect(
+                GL_TRIANGLES,
+                group.IndexType,
+                (void *)(_commandBase + group.FirstCommand * sizeof(DrawElementsIndirectCommand)),
+                static_cast<GLsizei>(group.CommandCount),
+                0
+            );
+            return;
+        }
+
+        // Without base instances, the draw index attribute is pointed at each command's draw instead
+        const size_t indexSize = Buffers::IndexSize(group.IndexType);
+        state.BindBuffer(GL_ARRAY_BUFFER, _drawIndexBuffer);
+
+        for (size_t i = group.FirstCommand; i < group.FirstCommand + group.CommandCount; ++i) {
+            const DrawElementsIndirectCommand &command = _commands[i];
+            const size_t drawOffset = command.BaseInstance * sizeof(GLuint);
+            glVertexAttribIPointer(DRAW_INDEX_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void *)drawOffset);
+            glDrawElementsBaseVertex(
+                GL_TRIANGLES,
+                static_cast<GLsizei>(command.Count),
+                group.IndexType,
+                (void *)(command.FirstIndex * indexSize),
+                command.BaseVertex
+            );
+        }
+    }
+
+    static void bindPacketMaterial(const DrawPacket &packet, Shader &shader) {
+        static_cast<const Group *>(packet.Source)->Material->BindMaterial(shader);
+    }
+
+    static bool sharesPacketMaterial(const DrawPacket &packet, const DrawPacket &other) {
+        const Mesh &material = *static_cast<const Group *>(other.Source)->Material;
+        return static_cast<const Group *>(packet.Source)->Material->SharesMaterial(material);
+    }
+
+    static void drawPacket(const DrawPacket &packet, Shader &shader, const RenderQueue &) {
+        const Group &group = *static_cast<const Group *>(packet.Source);
+        group.Batch->drawGroup(group, shader);
+    }
+
+public:
+    MultiDrawBatch() {
+        glGenBuffers(1, &_commandBuffer);
+        glGenBuffers(1, &_drawDataBuffer);
+        glGenBuffers(1, &_drawIndexBuffer);
+        glGenTextures(1, &_drawDataTexture);
+
+        StateCache &state = StateCache::Shared();
+        state.BindBuffer(GL_TEXTURE_BUFFER, _drawDataBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, MIN_DRAW_CAPACITY * sizeof(DrawData), nullptr, GL_STREAM_DRAW);
+        _drawDataCapacity = MIN_DRAW_CAPACITY * sizeof(DrawData);
+
+        // The texture refers to the buffer object, so it follows the buffer through every respecification
+        state.ActiveTexture(DRAW_DATA_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, _drawDataTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, _drawDataBuffer);
+
+        reserveDrawIndices(MIN_DRAW_CAPACITY);
+    }
+
+    MultiDrawBatch(const MultiDrawBatch &) = delete;
+    MultiDrawBatch &operator=(const MultiDrawBatch &) = delete;
+
+    ~MultiDrawBatch() {
+        StateCache &state = StateCache::Shared();
+        state.ForgetBuffer(_commandBuffer);
+        state.ForgetBuffer(_drawDataBuffer);
+        state.ForgetBuffer(_drawIndexBuffer);
+
+        glDeleteTextures(1, &_drawDataTexture);
+        glDeleteBuffers(1, &_commandBuffer);
+        glDeleteBuffers(1, &_drawDataBuffer);
+        glDeleteBuffers(1, &_drawIndexBuffer);
+    }
+
+    // Empties the batch for a new frame
+    void Begin() {
+        _objects.clear();
+        _draws.clear();
+        _drawGroups.clear();
+        _groups.clear();
+        _added.clear();
+    }
+
+    // A model instance whose meshes are added with `Add`
+    uint32_t AddObject(const glm::mat4 &model) {
+        RenderObject &object = _objects.emplace_back();
+        object.Model = model;
+        object.Rotation = glm::transpose(glm::inverse(glm::mat3(model)));
+        return static_cast<uint32_t>(_objects.size() - 1);
+    }
+
+    /**
+     * Adds `mesh` drawn with `shader` and the matrices of `object`, at `lod` or, when given, only the index `ranges`
+     * that survived culling. `shader` must be a `Shading::FEATURE_MULTI_DRAW` permutation.
+     */
+    void Add(
+        const Mesh &mesh, Shader &shader, uint32_t object, size_t lod, const Geometry::DrawRanges *ranges = nullptr
+    ) {
+        if (ranges && ranges->Counts.empty()) {
+            return;
+        }
+
+        const RenderObject &instance = _objects[object];
+        const PositionQuantization &quantization = mesh.Quantization();
+        DrawData &draw = _draws.emplace_back();
+
+        for (int column = 0; column < 4; ++column) {
+            draw.Model[column] = instance.Model[column];
+        }
+
+        for (int column = 0; column < 3; ++column) {
+            draw.Rotation[column] = glm::vec4(instance.Rotation[column], 0.0f);
+        }
+
+        draw.PositionOffset = glm::vec4(quantization.Offset, 0.0f);
+        draw.PositionScale = glm::vec4(quantization.Scale, 0.0f);
+
+        const uint32_t drawIndex = static_cast<uint32_t>(_draws.size() - 1);
+        _drawGroups.push_back(groupFor(mesh, shader));
+        mesh.AppendCommands(_added, drawIndex, lod, ranges);
+    }
+
+    /**
+     * Uploads the commands and per-draw data, and queues one packet per program and material on `queue`. Nothing may
+     * be added after this until the next `Begin`, since the packets point into the batch. With `ring`, the commands
+     * are written into its current frame instead of uploaded, whenever it has room.
+     */
+    void Flush(RenderQueue &queue, Buffers::FrameRingBuffer *ring = nullptr) {
+        _statistics = BatchStatistics();
+        _statistics.Draws = _draws.size();
+        _statistics.Commands = _added.size();
+
+        if (_added.empty()) {
+            return;
+        }
+
+        const size_t commandBytes = _added.size() * sizeof(DrawElementsIndirectCommand);
+        Buffers::RingAllocation ringCommands;
+
+        if (ring && Extensions::MultiDrawIndirectSupported) {
+            ringCommands = ring->Allocate(commandBytes, sizeof(GLuint));
+        }
+
+        if (ringCommands.Pointer) {
+            groupCommands(static_cast<DrawElementsIndirectCommand *>(ringCommands.Pointer));
+            _commandSource = ringCommands.Buffer;
+            _commandBase = ringCommands.Offset;
+        } else {
+            _commands.resize(_added.size());
+            groupCommands(_commands.data());
+            _commandSource = _commandBuffer;
+            _commandBase = 0;
+
+            if (Extensions::MultiDrawIndirectSupported) {
+                Buffers::UploadStream(
+                    GL_DRAW_INDIRECT_BUFFER,
+                    _commandBuffer,
+                    _commandCapacity,
+                    _commands.data(),
+                    commandBytes,
+                    MIN_DRAW_CAPACITY * sizeof(DrawElementsIndirectCommand)
+                );
+            }
+        }
+
+        Buffers::UploadStream(
+            GL_TEXTURE_BUFFER,
+            _drawDataBuffer,
+            _drawDataCapacity,
+            _draws.data(),
+            _draws.size() * sizeof(DrawData),
+            MIN_DRAW_CAPACITY * sizeof(DrawData)
+        );
+
+        reserveDrawIndices(_draws.size());
+
+        // The per-draw data replaces the object matrices, so every packet shares one placeholder object
+        const uint32_t object = queue.AddObject(glm::mat4(1.0f));
+
+        for (const Group &group : _groups) {
+            if (!group.CommandCount) {
+                continue;
+            }
+
+            prepareVertexArray(group.VertexArray);
+
+            DrawPacket packet;
+            packet.Program = group.Program;
+            packet.Material = group.MaterialKey;
+            packet.VertexArray = group.VertexArray;
+            packet.Object = object;
+            packet.Source = &group;
+            packet.BindMaterial = bindPacketMaterial;
+            packet.SharesMaterial = sharesPacketMaterial;
+            packet.Draw = drawPacket;
+            queue.Add(packet);
+
+            ++_statistics.Batches;
+        }
+    }
+
+    // Counts from the last `Flush`
+    const BatchStatistics &Statistics() const { return _statistics; }
+};
+} // namespace Render
+
+#endif
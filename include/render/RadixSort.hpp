@@ -0,0 +1,72 @@
+/**
+ * @file Least-significant-digit radix sort of 64-bit keys.
+ *
+ * A frame's draw list is a few hundred to a few thousand entries, re-sorted every frame. Eight counting passes over
+ * byte digits sort them in linear time, and passes whose byte is the same in every key, such as unused high bits,
+ * are skipped outright.
+ */
+
+#ifndef RENDER_RADIX_SORT_H
+#define RENDER_RADIX_SORT_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace Render {
+struct SortEntry {
+    uint64_t Key;
+    // Position of the sorted item in its owner's array
+    uint32_t Index;
+};
+
+/**
+ * Sorts `entries` by ascending key. Entries with equal keys keep their order. `scratch` is resized to match and its
+ * contents are overwritten, so callers keep it around to avoid reallocating every frame.
+ */
+inline void RadixSort(std::vector<SortEntry> &entries, std::vector<SortEntry> &scratch) {
+    constexpr size_t DIGIT_BITS = 8;
+    constexpr size_t BUCKETS = size_t(1) << DIGIT_BITS;
+
+    const size_t count = entries.size();
+    scratch.resize(count);
+
+    std::vector<SortEntry> *source = &entries;
+    std::vector<SortEntry> *destination = &scratch;
+
+    for (size_t shift = 0; shift < 64; shift += DIGIT_BITS) {
+        std::array<size_t, BUCKETS> offsets = {};
+
+        for (const SortEntry &entry : *source) {
+            ++offsets[(entry.Key >> shift) & (BUCKETS - 1)];
+        }
+
+        // Every key has the same digit here, so this pass would leave the order as it is
+        if (count == 0 || offsets[((*source)[0].Key >> shift) & (BUCKETS - 1)] == count) {
+            continue;
+        }
+
+        size_t total = 0;
+
+        for (size_t &offset : offsets) {
+            const size_t bucketSize = offset;
+            offset = total;
+            total += bucketSize;
+        }
+
+        for (const SortEntry &entry : *source) {
+            (*destination)[offsets[(entry.Key >> shift) & (BUCKETS - 1)]++] = entry;
+        }
+
+        std::swap(source, destination);
+    }
+
+    if (source != &entries) {
+        entries.swap(scratch);
+    }
+}
+} // namespace Render
+
+#endif
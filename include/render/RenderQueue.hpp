@@ -0,0 +1,266 @@
+/**
+ * @file A frame's draws, collected as packets, sorted by a packed 64-bit key and executed in that order.
+ *
+ * Objects submit packets instead of drawing, so the order no longer depends on the order they were submitted in.
+ * The key packs, from the top bit down:
+ *
+ *   opaque:      pass (2) | program (10) | material (16) | vertex array (10) | depth (24)
+ *   transparent: pass (2) | inverted depth (24) | program (10) | material (16) | vertex array (10)
+ *
+ * Opaque draws are grouped by state, which keeps program and material changes to a minimum, and go front to back
+ * within a group so early depth testing rejects hidden fragments. Transparent draws must blend back to front, so
+ * depth comes first for them.
+ */
+
+#ifndef RENDER_RENDER_QUEUE_H
+#define RENDER_RENDER_QUEUE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "geometry/Meshlets.hpp"
+#include "render/RadixSort.hpp"
+#include "render/StateCache.hpp"
+#include "shader.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Render {
+enum class RenderPass : uint8_t {
+    Opaque = 0,
+    Transparent = 1,
+};
+
+constexpr unsigned SORT_PASS_BITS = 2;
+constexpr unsigned SORT_PROGRAM_BITS = 10;
+constexpr unsigned SORT_MATERIAL_BITS = 16;
+constexpr unsigned SORT_VERTEX_ARRAY_BITS = 10;
+constexpr unsigned SORT_DEPTH_BITS = 24;
+
+static_assert(
+    SORT_PASS_BITS + SORT_PROGRAM_BITS + SORT_MATERIAL_BITS + SORT_VERTEX_ARRAY_BITS + SORT_DEPTH_BITS <= 64,
+    "sort key fields must fit in 64 bits"
+);
+
+// A packet without meshlet ranges
+constexpr uint32_t NO_RANGES = ~0u;
+
+// Per-object data shared by every packet an object submits
+struct RenderObject {
+    glm::mat4 Model = glm::mat4(1.0f);
+    // Normal matrix, worked out once per object rather than once per draw
+    glm::mat3 Rotation = glm::mat3(1.0f);
+};
+
+class RenderQueue;
+
+/**
+ * One draw. The queue sets the program and the object's matrices; `BindMaterial` runs only when the material differs
+ * from the previous packet's, and `Draw` issues the draw call itself. Equal `Material` keys may still collide, so a
+ * bind is only skipped when `SharesMaterial` confirms the match.
+ */
+struct DrawPacket {
+    RenderPass Pass = RenderPass::Opaque;
+    Shader *Program = nullptr;
+    // Equal for packets whose material can be bound once for all of them; zero for none
+    uint64_t Material = 0;
+    GLuint VertexArray = 0;
+    // Distance in front of the camera, from `RenderQueue::ViewDepth`
+    float Depth = 0.0f;
+    uint32_t Object = 0;
+    // Passed through to the callbacks, such as the mesh and its LOD
+    const void *Source = nullptr;
+    uint32_t Argument = 0;
+    // Copies drawn by one instanced call
+    uint32_t InstanceCount = 1;
+    uint32_t Ranges = NO_RANGES;
+    void (*BindMaterial)(const DrawPacket &packet, Shader &shader) = nullptr;
+    // Whether `other`, a packet with the same callbacks and key, binds exactly what `packet` does
+    bool (*SharesMaterial)(const DrawPacket &packet, const DrawPacket &other) = nullptr;
+    void (*Draw)(const DrawPacket &packet, Shader &shader, const RenderQueue &queue) = nullptr;
+};
+
+struct QueueStatistics {
+    size_t Packets = 0;
+    size_t ProgramChanges = 0;
+    size_t MaterialChanges = 0;
+    size_t ObjectChanges = 0;
+};
+
+class RenderQueue {
+private:
+    static constexpr uint32_t NONE = ~0u;
+
+    glm::mat4 _view = glm::mat4(1.0f);
+    float _farPlane = 100.0f;
+    std::vector<DrawPacket> _packets;
+    std::vector<RenderObject> _objects;
+    // Reused from frame to frame so the range vectors keep their capacity; only the first `_rangesUsed` are live
+    std::vector<Geometry::DrawRanges> _ranges;
+    size_t _rangesUsed = 0;
+    std::vector<SortEntry> _order;
+    std::vector<SortEntry> _scratch;
+    QueueStatistics _statistics;
+
+    static uint64_t field(uint64_t value, unsigned bits) { return value & ((uint64_t(1) << bits) - 1); }
+
+    uint64_t quantizeDepth(float depth) const {
+        constexpr float MAX_DEPTH = float((1u << SORT_DEPTH_BITS) - 1);
+        return static_cast<uint64_t>(std::clamp(depth / _farPlane, 0.0f, 1.0f) * MAX_DEPTH);
+    }
+
+    uint64_t sortKey(const DrawPacket &packet) const {
+        const uint64_t pass = static_cast<uint64_t>(packet.Pass);
+        const uint64_t program = field(packet.Program ? packet.Program->id : 0, SORT_PROGRAM_BITS);
+        const uint64_t material = field(packet.Material, SORT_MATERIAL_BITS);
+        const uint64_t vertexArray = field(packet.VertexArray, SORT_VERTEX_ARRAY_BITS);
+        const uint64_t depth = quantizeDepth(packet.Depth);
+
+        const uint64_t state = (program << (SORT_MATERIAL_BITS + SORT_VERTEX_ARRAY_BITS)) |
+                               (material << SORT_VERTEX_ARRAY_BITS) | vertexArray;
+        constexpr unsigned STATE_BITS = SORT_PROGRAM_BITS + SORT_MATERIAL_BITS + SORT_VERTEX_ARRAY_BITS;
+        constexpr unsigned PASS_SHIFT = STATE_BITS + SORT_DEPTH_BITS;
+
+        if (packet.Pass == RenderPass::Transparent) {
+            const uint64_t farthestFirst = field(~depth, SORT_DEPTH_BITS);
+            return (pass << PASS_SHIFT) | (farthestFirst << STATE_BITS) | state;
+        }
+
+        return (pass << PASS_SHIFT) | (state << SORT_DEPTH_BITS) | depth;
+    }
+
+    // Whether `packet` can skip binding its material because `bound` already did
+    static bool sharesMaterial(const DrawPacket &packet, const DrawPacket *bound) {
+        return bound && packet.Material == bound->Material && packet.BindMaterial == bound->BindMaterial &&
+               packet.SharesMaterial && packet.SharesMaterial == bound->SharesMaterial &&
+               packet.SharesMaterial(packet, *bound);
+    }
+
+    static void setBlending(bool enabled) {
+        if (enabled) {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glDepthMask(GL_FALSE);
+        } else {
+            glDisable(GL_BLEND);
+            glDepthMask(GL_TRUE);
+        }
+    }
+
+public:
+    /**
+     * Empties the queue for a frame seen through `view`. Depths are quantised over `[0, farPlane]`.
+     */
+    void Begin(const glm::mat4 &view, float farPlane) {
+        _view = view;
+        _farPlane = farPlane;
+        _packets.clear();
+        _objects.clear();
+        _rangesUsed = 0;
+    }
+
+    // Distance of `position` in front of the camera, for `DrawPacket::Depth`
+    float ViewDepth(const glm::vec3 &position) const { return -(_view * glm::vec4(position, 1.0f)).z; }
+
+    uint32_t AddObject(const glm::mat4 &model) {
+        RenderObject &object = _objects.emplace_back();
+        object.Model = model;
+        object.Rotation = glm::transpose(glm::inverse(glm::mat3(model)));
+        return static_cast<uint32_t>(_objects.size() - 1);
+    }
+
+    const RenderObject &Object(uint32_t index) const { return _objects[index]; }
+
+    // Keeps a copy of `ranges` until the next `Begin`, for `DrawPacket::Ranges`
+    uint32_t AddRanges(const Geometry::DrawRanges &ranges) {
+        if (_rangesUsed == _ranges.size()) {
+            _ranges.emplace_back();
+        }
+
+        Geometry::DrawRanges &copy = _ranges[_rangesUsed];
+        copy.Counts.assign(ranges.Counts.begin(), ranges.Counts.end());
+        copy.Offsets.assign(ranges.Offsets.begin(), ranges.Offsets.end());
+        copy.BaseVertices.assign(ranges.BaseVertices.begin(), ranges.BaseVertices.end());
+        copy.IndexByteOffset = ranges.IndexByteOffset;
+        copy.IndexSize = ranges.IndexSize;
+        copy.BaseVertex = ranges.BaseVertex;
+
+        return static_cast<uint32_t>(_rangesUsed++);
+    }
+
+    const Geometry::DrawRanges &Ranges(uint32_t index) const { return _ranges[index]; }
+
+    void Add(const DrawPacket &packet) { _packets.push_back(packet); }
+
+    size_t Size() const { return _packets.size(); }
+
+    /**
+     * Sorts the packets and draws them, switching program, object matrices and material only where they change.
+     */
+    void Execute() {
+        _order.resize(_packets.size());
+
+        for (size_t i = 0; i < _packets.size(); ++i) {
+            _order[i] = {sortKey(_packets[i]), static_cast<uint32_t>(i)};
+        }
+
+        RadixSort(_order, _scratch);
+
+        StateCache &state = StateCache::Shared();
+        Shader *program = nullptr;
+        uint32_t object = NONE;
+        // The packet whose material is bound, or null once a program change has dropped it
+        const DrawPacket *material = nullptr;
+        bool blending = false;
+
+        _statistics = QueueStatistics();
+        _statistics.Packets = _packets.size();
+
+        for (const SortEntry &entry : _order) {
+            const DrawPacket &packet = _packets[entry.Index];
+
+            if ((packet.Pass == RenderPass::Transparent) != blending) {
+                blending = !blending;
+                setBlending(blending);
+            }
+
+            if (packet.Program != program) {
+                program = packet.Program;
+                program->use();
+                object = NONE;
+                material = nullptr;
+                ++_statistics.ProgramChanges;
+            }
+
+            if (packet.Object != object) {
+                object = packet.Object;
+                program->setMat4(program->Standard().Model, _objects[object].Model);
+                program->setMat3(program->Standard().Rotation, _objects[object].Rotation);
+                ++_statistics.ObjectChanges;
+            }
+
+            if (packet.BindMaterial && !sharesMaterial(packet, material)) {
+                packet.BindMaterial(packet, *program);
+                material = &packet;
+                ++_statistics.MaterialChanges;
+            }
+
+            state.BindVertexArray(packet.VertexArray);
+            packet.Draw(packet, *program, *this);
+        }
+
+        if (blending) {
+            setBlending(false);
+        }
+    }
+
+    // Counts from the last `Execute`
+    const QueueStatistics &Statistics() const { return _statistics; }
+};
+} // namespace Render
+
+#endif
@@ -0,0 +1,188 @@
+/**
+ * @file Shadow copy of the GL bindings the renderer changes, so binds that would change nothing are never issued.
+ *
+ * Every program, vertex array, buffer and texture bind in the renderer goes through `StateCache::Shared()`. A bind
+ * made behind its back leaves the shadow wrong, so code that must call GL directly calls `Invalidate` afterwards.
+ * Deleting an object unbinds it in GL, so deletions are reported with the `Forget*` calls to keep the shadow in step.
+ *
+ * Objects such as `Buffers::FrameUniforms`, `Buffers::FrameRingBuffer` and `Render::MultiDrawBatch` create their GL
+ * objects in their constructor and delete them in their destructor, so they are built only once the context is current
+ * and must be gone before it is destroyed. The shared `Buffers::GeometryArena` and `Textures::TextureCache` outlive
+ * the context and never touch GL on destruction, so they are freed with `Release` and `Evict` while it is current;
+ * `Box` keeps its objects in statics, set up by `Init` and deleted by `Deinit`.
+ */
+
+#ifndef RENDER_STATE_CACHE_H
+#define RENDER_STATE_CACHE_H
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+
+#include "openGLExtensions.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Render {
+// Texture units whose 2D binding is shadowed; binds on higher units are always issued
+constexpr size_t TRACKED_TEXTURE_UNITS = 32;
+
+// Binding targets whose buffer is shadowed. The element array binding belongs to the vertex array, so it isn't
+constexpr GLenum TRACKED_BUFFER_TARGETS[] = {
+    GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_TEXTURE_BUFFER,
+    GL_DRAW_INDIRECT_BUFFER
+};
+
+struct StateStatistics {
+    // Calls that reached GL
+    size_t Issued = 0;
+    // Calls dropped because the state already matched
+    size_t Skipped = 0;
+};
+
+/**
+ * Tracks the bindings of the one GL context the renderer draws with. Starts out at GL's defaults, so create it, or
+ * call `Invalidate`, only once the context is current.
+ */
+class StateCache {
+private:
+    // Stands for a binding that must be issued whatever it is set to
+    static constexpr GLuint UNKNOWN = ~0u;
+
+    GLuint _program = 0;
+    GLuint _vertexArray = 0;
+    std::array<GLuint, std::size(TRACKED_BUFFER_TARGETS)> _buffers = {};
+    GLuint _activeUnit = 0;
+    std::array<GLuint, TRACKED_TEXTURE_UNITS> _textures = {};
+    StateStatistics _statistics;
+
+    static size_t bufferSlot(GLenum target) {
+        for (size_t slot = 0; slot < std::size(TRACKED_BUFFER_TARGETS); ++slot) {
+            if (TRACKED_BUFFER_TARGETS[slot] == target) {
+                return slot;
+            }
+        }
+
+        return std::size(TRACKED_BUFFER_TARGETS);
+    }
+
+    // Records `value` in `shadow` and returns whether GL needs to hear about it
+    bool change(GLuint &shadow, GLuint value) {
+        if (shadow == value) {
+            ++_statistics.Skipped;
+            return false;
+        }
+
+        shadow = value;
+        ++_statistics.Issued;
+        return true;
+    }
+
+    static void forget(GLuint &shadow, GLuint name) {
+        if (shadow == name) {
+            shadow = 0;
+        }
+    }
+
+public:
+    static StateCache &Shared() {
+        static StateCache cache;
+        return cache;
+    }
+
+    void UseProgram(GLuint program) {
+        if (change(_program, program)) {
+            glUseProgram(program);
+        }
+    }
+
+    void BindVertexArray(GLuint vertexArray) {
+        if (change(_vertexArray, vertexArray)) {
+            glBindVertexArray(vertexArray);
+        }
+    }
+
+    void BindBuffer(GLenum target, GLuint buffer) {
+        const size_t slot = bufferSlot(target);
+
+        if (slot == std::size(TRACKED_BUFFER_TARGETS)) {
+            ++_statistics.Issued;
+            glBindBuffer(target, buffer);
+        } else if (change(_buffers[slot], buffer)) {
+            glBindBuffer(target, buffer);
+        }
+    }
+
+    // Always issued, since indexed bindings aren't shadowed, but it also moves the target's generic binding
+    void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+        const size_t slot = bufferSlot(target);
+
+        if (slot != std::size(TRACKED_BUFFER_TARGETS)) {
+            _buffers[slot] = buffer;
+        }
+
+        ++_statistics.Issued;
+        glBindBufferRange(target, index, buffer, offset, size);
+    }
+
+    // Selects texture unit `unit`, counted from zero rather than from GL_TEXTURE0
+    void ActiveTexture(GLuint unit) {
+        if (change(_activeUnit, unit)) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+        }
+    }
+
+    // Binds a 2D texture to the active unit, such as for an upload
+    void BindTexture(GLuint texture) {
+        if (_activeUnit >= TRACKED_TEXTURE_UNITS) {
+            ++_statistics.Issued;
+            glBindTexture(GL_TEXTURE_2D, texture);
+        } else if (change(_textures[_activeUnit], texture)) {
+            glBindTexture(GL_TEXTURE_2D, texture);
+        }
+    }
+
+    // Binds a 2D texture to `unit`, only switching the active unit when the binding actually changes
+    void BindTexture(GLuint unit, GLuint texture) {
+        if (unit < TRACKED_TEXTURE_UNITS && _textures[unit] == texture) {
+            ++_statistics.Skipped;
+            return;
+        }
+
+        ActiveTexture(unit);
+        BindTexture(texture);
+    }
+
+    void ForgetProgram(GLuint program) { forget(_program, program); }
+
+    void ForgetVertexArray(GLuint vertexArray) { forget(_vertexArray, vertexArray); }
+
+    void ForgetBuffer(GLuint buffer) {
+        for (GLuint &bound : _buffers) {
+            forget(bound, buffer);
+        }
+    }
+
+    void ForgetTexture(GLuint texture) {
+        for (GLuint &bound : _textures) {
+            forget(bound, texture);
+        }
+    }
+
+    // Forces the next bind of everything to be issued, after GL state was changed without going through the cache
+    void Invalidate() {
+        _program = UNKNOWN;
+        _vertexArray = UNKNOWN;
+        _buffers.fill(UNKNOWN);
+        _activeUnit = UNKNOWN;
+        _textures.fill(UNKNOWN);
+    }
+
+    // Counts since the last `ResetStatistics`, typically one frame
+    const StateStatistics &Statistics() const { return _statistics; }
+
+    void ResetStatistics() { _statistics = StateStatistics(); }
+};
+} // namespace Render
+
+#endif
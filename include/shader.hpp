@@ -1,153 +1,504 @@
 #ifndef SHADER_H
 #define SHADER_H
 
-#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <deque>
 #include <iostream>
-#include <sstream>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include "glm/fwd.hpp"
 
+#include "buffers/UniformBlocks.hpp"
+#include "cache/ProgramCache.hpp"
 #include "lights/DirectionalLight.hpp"
 #include "lights/PointLight.hpp"
 #include "lights/SpotLight.hpp"
+#include "render/StateCache.hpp"
+#include "shading/ShaderPreprocessor.hpp"
 
 #include "openGLCommon.hpp"
+#include "openGLExtensions.hpp"
+
+struct ShaderOptions {
+    // Load the linked program from a binary stored by an earlier run, and store one after compiling
+    bool UseProgramCache = true;
+    // Return as soon as the build is submitted. The program is finished, waiting on the driver if it has to, by
+    // `Shader::Finish` or the first `use`
+    bool Async = false;
+    // `#define` lines inserted after `#version` in both stages, such as `Shading::FeatureDefines` of a permutation
+    std::string Defines;
+};
 
-class Shader {
-private:
-    static const unsigned short infoLogSize = 512;
+struct ShaderBuildStatistics {
+    // Programs compiled from source rather than loaded from the program cache
+    size_t Compiled = 0;
+    // Compiled programs the driver had already finished when they were first needed
+    size_t ReadyWhenUsed = 0;
+    // Time spent waiting on the driver to finish compiled programs
+    double WaitMilliseconds = 0.0;
+};
 
-    std::string readShaderFile(std::string path) {
-        std::string shaderCode;
-        std::ifstream shaderFile;
+// Totals over every program built this run
+inline ShaderBuildStatistics &ShaderBuildCounters() {
+    static ShaderBuildStatistics statistics;
+    return statistics;
+}
 
-        shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+struct ColorUniforms {
+    GLint Ambient = -1;
+    GLint Diffuse = -1;
+    GLint Specular = -1;
+};
 
-        try {
-            shaderFile.open(path);
-            std::stringstream shaderStream;
+struct AttenuationUniforms {
+    GLint Constant = -1;
+    GLint Linear = -1;
+    GLint Quadratic = -1;
+};
 
-            shaderStream << shaderFile.rdbuf();
-            shaderCode = shaderStream.str();
+struct DirectionalLightUniforms {
+    ColorUniforms Color;
+    GLint Direction = -1;
+};
 
-            shaderFile.close();
-        } catch (const std::ifstream::failure &e) {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
-            std::cout << "path: " << path << "\ncode: " << e.code() << "\nwhat: " << e.what() << std::endl;
-        }
+struct PointLightUniforms {
+    ColorUniforms Color;
+    AttenuationUniforms Attenuation;
+    GLint Position = -1;
+};
+
+struct SpotLightUniforms {
+    ColorUniforms Color;
+    AttenuationUniforms Attenuation;
+    GLint Position = -1;
+    GLint Direction = -1;
+    GLint InnerRadius = -1;
+    GLint OuterRadius = -1;
+};
 
-        return shaderCode;
+/**
+ * Locations of the uniforms set on every draw, resolved once after linking. A program without one of them gets -1,
+ * which `glUniform*` ignores.
+ */
+struct StandardUniforms {
+    GLint Model = -1;
+    GLint Rotation = -1;
+    GLint LightColor = -1;
+    GLint Shininess = -1;
+    GLint PackedVertices = -1;
+    GLint PositionOffset = -1;
+    GLint PositionScale = -1;
+    GLint DrawData = -1;
+};
+
+class Shader {
+private:
+    static const unsigned short infoLogSize = 512;
+
+    // Owns the names the location table's keys point into; a deque never moves its elements
+    std::deque<std::string> uniformNames;
+    std::unordered_map<std::string_view, GLint> uniformLocations;
+    // Sampler locations by material texture type, such as "texture_diffuse", indexed by the type's number
+    std::unordered_map<std::string, std::vector<GLint>> materialSamplers;
+    StandardUniforms standardUniforms;
+    DirectionalLightUniforms directionalLightUniforms;
+    SpotLightUniforms spotLightUniforms;
+    std::vector<PointLightUniforms> pointLightUniforms;
+
+    // Shader objects of a build still owned by the driver; zero once the program is finished
+    GLuint pendingVertex = 0;
+    GLuint pendingFragment = 0;
+    bool finished = false;
+    // Where `Finish` stores the binary of a program built from source; empty when there is nothing to store
+    std::string cachePath;
+    uint64_t cacheKey = 0;
+
+    GLuint submitShader(GLenum type, const std::string &shaderCode) {
+        const GLuint shader = glCreateShader(type);
+        const char *source = shaderCode.c_str();
+
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+
+        return shader;
     }
 
-    void compileShader(unsigned int shader, const char *shaderCode) {
+    bool checkShader(GLuint shader, const char *stage) {
         int success;
         char infoLog[infoLogSize];
 
-        glShaderSource(shader, 1, &shaderCode, NULL);
-        glCompileShader(shader);
         glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
 
         if (!success) {
             glGetShaderInfoLog(shader, infoLogSize, NULL, infoLog);
-            std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+            std::cout << "ERROR::SHADER::" << stage << "::COMPILATION_FAILED\n" << infoLog << std::endl;
         }
+
+        return success;
     }
 
-    void linkProgram(unsigned int vertex, unsigned int fragment) {
+    bool checkProgram() {
         int success;
         char infoLog[infoLogSize];
 
-        glAttachShader(id, vertex);
-        glAttachShader(id, fragment);
-        glLinkProgram(id);
         glGetProgramiv(id, GL_LINK_STATUS, &success);
 
         if (!success) {
             glGetProgramInfoLog(id, infoLogSize, NULL, infoLog);
             std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
         }
+
+        return success;
+    }
+
+    /**
+     * Hands both compiles and the link to the driver without asking for any result, so a driver with parallel
+     * compilation works on them in the background until `finishProgram`.
+     */
+    void submitProgram(const std::string &vertexShaderCode, const std::string &fragmentShaderCode) {
+        pendingVertex = submitShader(GL_VERTEX_SHADER, vertexShaderCode);
+        pendingFragment = submitShader(GL_FRAGMENT_SHADER, fragmentShaderCode);
+
+        glAttachShader(id, pendingVertex);
+        glAttachShader(id, pendingFragment);
+        glLinkProgram(id);
+    }
+
+    // Waits for the submitted build and reports its errors
+    bool finishProgram() {
+        checkShader(pendingVertex, "VERTEX");
+        checkShader(pendingFragment, "FRAGMENT");
+
+        const bool linked = checkProgram();
+
+        glDetachShader(id, pendingVertex);
+        glDetachShader(id, pendingFragment);
+        glDeleteShader(pendingVertex);
+        glDeleteShader(pendingFragment);
+        pendingVertex = 0;
+        pendingFragment = 0;
+
+        return linked;
+    }
+
+    /**
+     * Points the program's block `name`, if it has one, at `binding`. A block larger than its C++ mirror means the
+     * GLSL and the struct have drifted apart.
+     */
+    void bindUniformBlock(const char *name, GLuint binding, size_t size) {
+        const GLuint index = glGetUniformBlockIndex(id, name);
+
+        if (index == GL_INVALID_INDEX) {
+            return;
+        }
+
+        GLint dataSize = 0;
+        glGetActiveUniformBlockiv(id, index, GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+
+        if (static_cast<size_t>(dataSize) > size) {
+            std::cout << "ERROR::SHADER::UNIFORM_BLOCK_SIZE_MISMATCH\nblock: " << name << "\nexpected: " << size
+                      << "\nactual: " << dataSize << std::endl;
+        }
+
+        glUniformBlockBinding(id, index, binding);
+    }
+
+    void addUniform(std::string name, GLint location) {
+        const std::string_view key = uniformNames.emplace_back(std::move(name));
+        uniformLocations.emplace(key, location);
+    }
+
+    /**
+     * Records the location of every active uniform, plus each element of uniform arrays, so no name is ever looked up
+     * through GL again.
+     */
+    void reflectUniforms() {
+        GLint count = 0;
+        GLint maxLength = 0;
+        glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::vector<char> buffer(std::max(maxLength, 1));
+
+        for (GLint i = 0; i < count; ++i) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(id, i, static_cast<GLsizei>(buffer.size()), &length, &size, &type, buffer.data());
+
+            std::string name(buffer.data(), length);
+            const GLint location = glGetUniformLocation(id, name.c_str());
+
+            // Members of uniform blocks have no location
+            if (location < 0) {
+                continue;
+            }
+
+            const size_t arraySuffix = name.size() >= 3 ? name.rfind("[0]") : std::string::npos;
+
+            if (arraySuffix != std::string::npos && arraySuffix == name.size() - 3) {
+                const std::string base = name.substr(0, arraySuffix);
+
+                for (GLint element = 1; element < size; ++element) {
+                    const std::string elementName = base + "[" + std::to_string(element) + "]";
+                    addUniform(elementName, glGetUniformLocation(id, elementName.c_str()));
+                }
+
+                addUniform(base, location);
+            }
+
+            addMaterialSampler(name, location);
+            addUniform(std::move(name), location);
+        }
+
+        resolveStandardUniforms();
+    }
+
+    // Files `material.<type><number>` samplers under their type so meshes can find them without building names
+    void addMaterialSampler(const std::string &name, GLint location) {
+        static const std::string prefix = "material.";
+
+        if (name.compare(0, prefix.size(), prefix) != 0 || name.compare(prefix.size(), 8, "texture_") != 0) {
+            return;
+        }
+
+        size_t digits = name.size();
+
+        while (digits > prefix.size() && std::isdigit(static_cast<unsigned char>(name[digits - 1]))) {
+            --digits;
+        }
+
+        if (digits == name.size()) {
+            return;
+        }
+
+        const size_t index = std::stoul(name.substr(digits));
+        std::vector<GLint> &locations = materialSamplers[name.substr(prefix.size(), digits - prefix.size())];
+
+        if (locations.size() <= index) {
+            locations.resize(index + 1, -1);
+        }
+
+        locations[index] = location;
+    }
+
+    ColorUniforms colorUniforms(const std::string &prefix) const {
+        return {Uniform(prefix + "ambient"), Uniform(prefix + "diffuse"), Uniform(prefix + "specular")};
+    }
+
+    AttenuationUniforms attenuationUniforms(const std::string &prefix) const {
+        return {Uniform(prefix + "constant"), Uniform(prefix + "linear"), Uniform(prefix + "quadratic")};
+    }
+
+    void resolveStandardUniforms() {
+        standardUniforms.Model = Uniform("model");
+        standardUniforms.Rotation = Uniform("rotation");
+        standardUniforms.LightColor = Uniform("lightColor");
+        standardUniforms.Shininess = Uniform("material.shininess");
+        standardUniforms.PackedVertices = Uniform("packedVertices");
+        standardUniforms.PositionOffset = Uniform("positionOffset");
+        standardUniforms.PositionScale = Uniform("positionScale");
+        standardUniforms.DrawData = Uniform("drawData");
+
+        directionalLightUniforms.Color = colorUniforms("directionalLight.color.");
+        directionalLightUniforms.Direction = Uniform("directionalLight.direction");
+
+        spotLightUniforms.Color = colorUniforms("spotLight.color.");
+        spotLightUniforms.Attenuation = attenuationUniforms("spotLight.attenuation.");
+        spotLightUniforms.Position = Uniform("spotLight.position");
+        spotLightUniforms.Direction = Uniform("spotLight.direction");
+        spotLightUniforms.InnerRadius = Uniform("spotLight.innerRadius");
+        spotLightUniforms.OuterRadius = Uniform("spotLight.outerRadius");
+
+        // Point lights are an array of structs, so each element's members are separate uniforms
+        for (size_t index = 0;; ++index) {
+            const std::string prefix = "pointLights[" + std::to_string(index) + "].";
+
+            PointLightUniforms light;
+            light.Color = colorUniforms(prefix + "color.");
+            light.Attenuation = attenuationUniforms(prefix + "attenuation.");
+            light.Position = Uniform(prefix + "position");
+
+            if (light.Position < 0 && light.Color.Ambient < 0 && light.Color.Diffuse < 0 && light.Color.Specular < 0) {
+                break;
+            }
+
+            pointLightUniforms.push_back(light);
+        }
     }
 
 public:
     unsigned int id;
 
-    Shader(std::string vertexPath, std::string fragmentPath) {
-        std::string vertexShaderCode = readShaderFile(vertexPath);
-        std::string fragmentShaderCode = readShaderFile(fragmentPath);
+    Shader(std::string vertexPath, std::string fragmentPath, ShaderOptions options = ShaderOptions()) {
+        const std::string vertexShaderCode = Shading::PreprocessShader(vertexPath, options.Defines);
+        const std::string fragmentShaderCode = Shading::PreprocessShader(fragmentPath, options.Defines);
 
-        unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
-        unsigned int fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        id = glCreateProgram();
 
-        compileShader(vertex, vertexShaderCode.c_str());
-        compileShader(fragment, fragmentShaderCode.c_str());
+        const bool cached = options.UseProgramCache && Extensions::ProgramBinarySupported;
+        cacheKey = cached ? Cache::ProgramCacheKey(vertexShaderCode, fragmentShaderCode, options.Defines) : 0;
+        const std::string path = cached ? Cache::ProgramCachePath(fragmentPath, cacheKey) : "";
 
-        id = glCreateProgram();
-        linkProgram(vertex, fragment);
+        // A missing or rejected binary leaves the program unlinked, so it is simply built from source instead
+        if (!cached || !Cache::LoadProgramBinary(id, path, cacheKey)) {
+            if (cached) {
+                Extensions::ProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+                cachePath = path;
+            }
+
+            submitProgram(vertexShaderCode, fragmentShaderCode);
+            ++ShaderBuildCounters().Compiled;
+        }
 
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+        if (!options.Async) {
+            Finish();
+        }
     }
 
-    void use() { glUseProgram(id); }
+    // The location table points into the owned names, so a shader stays where it was built
+    Shader(const Shader &) = delete;
+    Shader &operator=(const Shader &) = delete;
+
+    /**
+     * Whether the driver has finished building the program, so `Finish` and `use` won't wait. Without parallel shader
+     * compilation the driver can't be asked without waiting on it, so this is always true.
+     */
+    bool IsReady() const {
+        if (finished || !pendingVertex || !Extensions::ParallelShaderCompileSupported) {
+            return true;
+        }
 
-    void setDirectionalLight(const Light::DirectionalLight &light) const {
-        setVec3("directionalLight.color.ambient", light.color.ambient);
-        setVec3("directionalLight.color.diffuse", light.color.diffuse);
-        setVec3("directionalLight.color.specular", light.color.specular);
-        setVec3("directionalLight.direction", light.direction);
+        GLint completed = GL_FALSE;
+        glGetProgramiv(id, GL_COMPLETION_STATUS_KHR, &completed);
+        return completed;
     }
 
-    void setPointLight(const Light::PointLight &light, GLint index) const {
-        std::string name = "pointLights[" + std::to_string(index) + "].";
-        setVec3(name + "position", light.position);
-        setVec3(name + "color.ambient", light.color.ambient);
-        setVec3(name + "color.diffuse", light.color.diffuse);
-        setVec3(name + "color.specular", light.color.specular);
-        setFloat(name + "attenuation.constant", light.attenuation.constant);
-        setFloat(name + "attenuation.linear", light.attenuation.linear);
-        setFloat(name + "attenuation.quadratic", light.attenuation.quadratic);
+    /**
+     * Waits for the build if it is still running, then resolves the program's uniforms and blocks. Until then the
+     * location lookups below all report -1.
+     */
+    void Finish() {
+        if (finished) {
+            return;
+        }
+
+        // Asked before `finished` is set, since `IsReady` reports a finished program as ready without querying GL
+        const bool ready = pendingVertex && Extensions::ParallelShaderCompileSupported && IsReady();
+        finished = true;
+
+        if (pendingVertex) {
+            ShaderBuildStatistics &statistics = ShaderBuildCounters();
+            const auto start = std::chrono::steady_clock::now();
+
+            const bool linked = finishProgram();
+
+            const std::chrono::duration<double, std::milli> waited = std::chrono::steady_clock::now() - start;
+            statistics.WaitMilliseconds += waited.count();
+            statistics.ReadyWhenUsed += ready;
+
+            if (linked && !cachePath.empty()) {
+                Cache::SaveProgramBinary(id, cachePath, cacheKey);
+            }
+        }
+
+        reflectUniforms();
+        bindUniformBlock(Buffers::CAMERA_BLOCK_NAME, Buffers::CAMERA_BLOCK_BINDING, sizeof(Buffers::CameraBlock));
+        bindUniformBlock(Buffers::LIGHT_BLOCK_NAME, Buffers::LIGHT_BLOCK_BINDING, sizeof(Buffers::LightBlock));
     }
 
-    void setSpotLight(const Light::SpotLight &light) const {
-        setVec3("spotLight.position", light.position);
-        setVec3("spotLight.direction", light.direction);
-        setFloat("spotLight.innerRadius", light.innerRadius);
-        setFloat("spotLight.outerRadius", light.outerRadius);
-        setVec3("spotLight.color.ambient", light.color.ambient);
-        setVec3("spotLight.color.diffuse", light.color.diffuse);
-        setVec3("spotLight.color.specular", light.color.specular);
-        setFloat("spotLight.attenuation.constant", light.attenuation.constant);
-        setFloat("spotLight.attenuation.linear", light.attenuation.linear);
-        setFloat("spotLight.attenuation.quadratic", light.attenuation.quadratic);
+    void use() {
+        Finish();
+        Render::StateCache::Shared().UseProgram(id);
+    }
+
+    // Location of an active uniform from the table built at link time, or -1
+    GLint Uniform(std::string_view name) const {
+        const auto found = uniformLocations.find(name);
+        return found == uniformLocations.end() ? -1 : found->second;
+    }
+
+    const StandardUniforms &Standard() const { return standardUniforms; }
+
+    // Location of `material.<type><index>`, or -1 when the program has no such sampler
+    GLint MaterialSampler(const std::string &type, size_t index) const {
+        const auto found = materialSamplers.find(type);
+        return found == materialSamplers.end() || index >= found->second.size() ? -1 : found->second[index];
     }
 
-    void setBool(const std::string &name, bool value) const {
-        glUniform1i(glGetUniformLocation(id, name.c_str()), (int)value);
+    void setColor(const ColorUniforms &uniforms, const Color::Color &color) const {
+        setVec3(uniforms.Ambient, color.ambient);
+        setVec3(uniforms.Diffuse, color.diffuse);
+        setVec3(uniforms.Specular, color.specular);
     }
 
-    void setInt(const std::string &name, int value) const {
-        glUniform1i(glGetUniformLocation(id, name.c_str()), value);
+    void setAttenuation(const AttenuationUniforms &uniforms, const Light::Attenuation &attenuation) const {
+        setFloat(uniforms.Constant, attenuation.constant);
+        setFloat(uniforms.Linear, attenuation.linear);
+        setFloat(uniforms.Quadratic, attenuation.quadratic);
+    }
+
+    void setDirectionalLight(const Light::DirectionalLight &light) const {
+        setColor(directionalLightUniforms.Color, light.color);
+        setVec3(directionalLightUniforms.Direction, light.direction);
     }
 
-    void setFloat(const std::string &name, float value) const {
-        glUniform1f(glGetUniformLocation(id, name.c_str()), value);
+    void setPointLight(const Light::PointLight &light, GLint index) const {
+        if (index < 0 || static_cast<size_t>(index) >= pointLightUniforms.size()) {
+            return;
+        }
+
+        const PointLightUniforms &uniforms = pointLightUniforms[index];
+        setVec3(uniforms.Position, light.position);
+        setColor(uniforms.Color, light.color);
+        setAttenuation(uniforms.Attenuation, light.attenuation);
     }
 
-    void setMat3(const std::string &name, glm::mat3 value) const {
-        glUniformMatrix3fv(glGetUniformLocation(id, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+    void setSpotLight(const Light::SpotLight &light) const {
+        setVec3(spotLightUniforms.Position, light.position);
+        setVec3(spotLightUniforms.Direction, light.direction);
+        setFloat(spotLightUniforms.InnerRadius, light.innerRadius);
+        setFloat(spotLightUniforms.OuterRadius, light.outerRadius);
+        setColor(spotLightUniforms.Color, light.color);
+        setAttenuation(spotLightUniforms.Attenuation, light.attenuation);
     }
 
-    void setMat4(const std::string &name, glm::mat4 value) const {
-        glUniformMatrix4fv(glGetUniformLocation(id, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+    void setBool(GLint location, bool value) const { glUniform1i(location, (int)value); }
+
+    void setInt(GLint location, int value) const { glUniform1i(location, value); }
+
+    void setFloat(GLint location, float value) const { glUniform1f(location, value); }
+
+    void setMat3(GLint location, const glm::mat3 &value) const {
+        glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value));
     }
 
-    void setVec3(const std::string &name, glm::vec3 value) const {
-        glUniform3fv(glGetUniformLocation(id, name.c_str()), 1, glm::value_ptr(value));
+    void setMat4(GLint location, const glm::mat4 &value) const {
+        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
     }
+
+    void setVec3(GLint location, const glm::vec3 &value) const { glUniform3fv(location, 1, glm::value_ptr(value)); }
+
+    void setBool(std::string_view name, bool value) const { setBool(Uniform(name), value); }
+
+    void setInt(std::string_view name, int value) const { setInt(Uniform(name), value); }
+
+    void setFloat(std::string_view name, float value) const { setFloat(Uniform(name), value); }
+
+    void setMat3(std::string_view name, const glm::mat3 &value) const { setMat3(Uniform(name), value); }
+
+    void setMat4(std::string_view name, const glm::mat4 &value) const { setMat4(Uniform(name), value); }
+
+    void setVec3(std::string_view name, const glm::vec3 &value) const { setVec3(Uniform(name), value); }
 };
 
 #endif
@@ -0,0 +1,74 @@
+/**
+ * @file Feature bits that select a permutation of the lit material shader.
+ *
+ * A permutation is compiled with only the code its features need: a mesh without a normal map skips the tangent
+ * frame and the normal fetch, one without a specular map skips the specular term, and a fixed point light count lets
+ * the light loop unroll. The bits are also the key the compiled permutations are cached under.
+ */
+
+#ifndef SHADING_SHADER_FEATURES_H
+#define SHADING_SHADER_FEATURES_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+namespace Shading {
+constexpr uint32_t FEATURE_NORMAL_MAP = 1u << 0;
+constexpr uint32_t FEATURE_SPECULAR_MAP = 1u << 1;
+// Material features, as opposed to the light count bits above them
+constexpr uint32_t MATERIAL_FEATURES = FEATURE_NORMAL_MAP | FEATURE_SPECULAR_MAP;
+
+// Model matrices and vertex decoding come from the per-draw data of `Render::MultiDrawBatch` instead of uniforms
+constexpr uint32_t FEATURE_MULTI_DRAW = 1u << 2;
+
+// Point light count plus one, so zero means the count is read from the light block at run time. The count must not
+// exceed the light block's capacity.
+constexpr uint32_t POINT_LIGHT_SHIFT = 8;
+constexpr uint32_t POINT_LIGHT_MASK = 0xffu << POINT_LIGHT_SHIFT;
+
+inline uint32_t PointLightFeature(size_t count) {
+    return static_cast<uint32_t>(std::min<size_t>(count, 0xfe) + 1) << POINT_LIGHT_SHIFT;
+}
+
+// Material features of a mesh's textures, by their `texture_<kind>` type names
+inline uint32_t TextureFeature(const std::string &type) {
+    if (type == "texture_normal") {
+        return FEATURE_NORMAL_MAP;
+    }
+
+    if (type == "texture_specular") {
+        return FEATURE_SPECULAR_MAP;
+    }
+
+    return 0;
+}
+
+/**
+ * The `#define` lines that specialise the shader sources for `features`.
+ */
+inline std::string FeatureDefines(uint32_t features) {
+    std::string defines;
+
+    if (features & FEATURE_NORMAL_MAP) {
+        defines += "#define HAS_NORMAL_MAP\n";
+    }
+
+    if (features & FEATURE_SPECULAR_MAP) {
+        defines += "#define HAS_SPECULAR_MAP\n";
+    }
+
+    if (features & FEATURE_MULTI_DRAW) {
+        defines += "#define MULTI_DRAW\n";
+    }
+
+    if (features & POINT_LIGHT_MASK) {
+        const uint32_t pointLights = ((features & POINT_LIGHT_MASK) >> POINT_LIGHT_SHIFT) - 1;
+        defines += "#define POINT_LIGHT_COUNT " + std::to_string(pointLights) + "\n";
+    }
+
+    return defines;
+}
+} // namespace Shading
+
+#endif
@@ -0,0 +1,133 @@
+/**
+ * @file Expands `#include` in GLSL sources and specialises them with permutation defines.
+ *
+ * GLSL 3.30 has no include directive, so the shared camera and light declarations in `shaders/include/` are pasted
+ * in here before the source reaches the driver. Every file gets a source string number in `#line` directives, in the
+ * order it was first included, so compile errors still point at the right file and line: `0:12` is line 12 of the
+ * top-level file, `1:4` line 4 of the first include.
+ */
+
+#ifndef SHADING_SHADER_PREPROCESSOR_H
+#define SHADING_SHADER_PREPROCESSOR_H
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace Shading {
+inline bool ReadSourceFile(const std::string &path, std::string &source) {
+    std::ifstream file(path);
+
+    if (!file) {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ\npath: " << path << std::endl;
+        return false;
+    }
+
+    std::stringstream stream;
+    stream << file.rdbuf();
+    source = stream.str();
+    return true;
+}
+
+// The quoted path of an `#include "path"` line, or an empty string for any other line
+inline std::string IncludedPath(const std::string &line) {
+    const size_t start = line.find_first_not_of(" \t");
+
+    if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+        return "";
+    }
+
+    const size_t open = line.find('"', start + 8);
+    const size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+    return close == std::string::npos ? "" : line.substr(open + 1, close - open - 1);
+}
+
+inline bool IsVersionLine(const std::string &line) {
+    const size_t start = line.find_first_not_of(" \t");
+    return start != std::string::npos && line.compare(start, 8, "#version") == 0;
+}
+
+/**
+ * Appends `path` to `output` with its includes expanded. A file already in `files` expands to nothing, so shared
+ * headers need no include guards. `defines` follows the first `#version` line of the top-level file, which fails
+ * without one rather than drop them.
+ */
+inline bool ExpandSource(
+    const std::filesystem::path &path, const std::string &defines, std::vector<std::string> &files, std::string &output
+) {
+    const std::string key = path.lexically_normal().string();
+    const size_t fileNumber = files.size();
+    files.push_back(key);
+
+    std::string source;
+
+    if (!ReadSourceFile(key, source)) {
+        return false;
+    }
+
+    std::istringstream lines(source);
+    std::string line;
+    size_t lineNumber = 0;
+    bool definesInserted = defines.empty();
+
+    if (fileNumber > 0) {
+        output += "#line 1 " + std::to_string(fileNumber) + "\n";
+    }
+
+    while (std::getline(lines, line)) {
+        ++lineNumber;
+        const std::string included = IncludedPath(line);
+
+        if (!included.empty()) {
+            const std::filesystem::path includedPath = (path.parent_path() / included).lexically_normal();
+
+            if (std::find(files.begin(), files.end(), includedPath.string()) == files.end() &&
+                !ExpandSource(includedPath, "", files, output)) {
+                std::cout << "included from: " << key << ":" << lineNumber << std::endl;
+                return false;
+            }
+
+            output += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileNumber) + "\n";
+            continue;
+        }
+
+        output += line;
+        output += '\n';
+
+        if (!definesInserted && IsVersionLine(line)) {
+            output += defines;
+            output += "#line " + std::to_string(lineNumber + 1) + " 0\n";
+            definesInserted = true;
+        }
+    }
+
+    if (!definesInserted) {
+        std::cout << "ERROR::SHADER::MISSING_VERSION\npath: " << key << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Reads the shader at `path` with every `#include "file"` replaced by that file, resolved relative to the file that
+ * includes it. `defines`, one `#define` per line, is inserted after the first `#version`. Returns an empty string when
+ * any file can't be read, or when there are defines but no `#version` to put them after.
+ */
+inline std::string PreprocessShader(const std::string &path, const std::string &defines = "") {
+    std::vector<std::string> files;
+    std::string output;
+
+    if (!ExpandSource(path, defines, files, output)) {
+        return "";
+    }
+
+    return output;
+}
+} // namespace Shading
+
+#endif
@@ -0,0 +1,69 @@
+/**
+ * @file Compiled permutations of one vertex and fragment shader pair, built on first use.
+ */
+
+#ifndef SHADING_SHADER_VARIANTS_H
+#define SHADING_SHADER_VARIANTS_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "shader.hpp"
+#include "shading/ShaderFeatures.hpp"
+
+namespace Shading {
+/**
+ * Caches one `Shader` per feature bitmask. Each permutation is compiled, or loaded from the program cache, the first
+ * time it is asked for, so only the combinations the scene actually uses are ever built. With `ShaderOptions::Async`,
+ * `Prepare` can submit the expected ones early and leave the driver to build them while the caller does other work.
+ */
+class ShaderVariants {
+private:
+    std::string _vertexPath;
+    std::string _fragmentPath;
+    ShaderOptions _options;
+    std::unordered_map<uint32_t, std::unique_ptr<Shader>> _variants;
+
+public:
+    ShaderVariants(std::string vertexPath, std::string fragmentPath, ShaderOptions options = ShaderOptions()) :
+        _vertexPath(std::move(vertexPath)), _fragmentPath(std::move(fragmentPath)), _options(std::move(options)) {}
+
+    ShaderVariants(const ShaderVariants &) = delete;
+    ShaderVariants &operator=(const ShaderVariants &) = delete;
+
+    // The permutation built for exactly `features`, appended to any defines the options already carry
+    Shader &Get(uint32_t features) {
+        std::unique_ptr<Shader> &variant = _variants[features];
+
+        if (!variant) {
+            ShaderOptions options = _options;
+            options.Defines += FeatureDefines(features);
+            variant = std::make_unique<Shader>(_vertexPath, _fragmentPath, options);
+        }
+
+        return *variant;
+    }
+
+    // Starts building the permutation for `features` without waiting for it
+    void Prepare(uint32_t features) { Get(features); }
+
+    // Starts building every combination of material features on top of `sceneFeatures`
+    void PrepareMaterials(uint32_t sceneFeatures) {
+        for (uint32_t material = MATERIAL_FEATURES;; material = (material - 1) & MATERIAL_FEATURES) {
+            Prepare(sceneFeatures | material);
+
+            if (material == 0) {
+                break;
+            }
+        }
+    }
+
+    // Permutations built so far
+    size_t Count() const { return _variants.size(); }
+};
+} // namespace Shading
+
+#endif
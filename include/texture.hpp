@@ -2,6 +2,7 @@
 #define TEXTURE_H
 
 #include <string>
+#include <utility>
 
 #include "openGLCommon.hpp"
 
@@ -10,7 +11,17 @@ struct Texture {
     std::string Type;
     std::string Path;
 
-    Texture(GLuint id, std::string type, std::string path) : ID(id), Type(type), Path(path) {}
+    Texture(GLuint id, std::string type, std::string path) : ID(id), Type(std::move(type)), Path(std::move(path)) {}
+};
+
+/**
+ * A texture a mesh wants, named by its path relative to the model's directory.
+ */
+struct TextureReference {
+    std::string Type;
+    std::string Path;
+
+    TextureReference(std::string type, std::string path) : Type(std::move(type)), Path(std::move(path)) {}
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,208 @@
+/**
+ * @file Decodes textures on worker threads and uploads them on the GL thread a few at a time.
+ *
+ * `Request` hands back a real texture name straight away, filled with a one texel placeholder, so meshes can be
+ * drawn before their maps have been decoded. Decoder threads push finished images into a bounded queue; once it is
+ * full they wait, which caps how many decoded 4K images sit in memory at once. The render loop drains the queue with
+ * `ProcessUploads`, spending at most a given time budget per frame.
+ */
+
+#ifndef TEXTURES_ASYNC_TEXTURE_LOADER_H
+#define TEXTURES_ASYNC_TEXTURE_LOADER_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "textures/Image.hpp"
+#include "textures/TextureLoading.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Textures {
+class AsyncTextureLoader {
+private:
+    struct PendingTexture {
+        GLuint TextureId;
+        std::string Path;
+        std::string Type;
+        TextureSettings Settings;
+    };
+
+    struct DecodedTexture {
+        GLuint TextureId;
+        PreparedTexture Texture;
+    };
+
+    std::vector<std::thread> _decoders;
+    std::deque<PendingTexture> _requests;
+    std::deque<DecodedTexture> _ready;
+    size_t _readyCapacity;
+    size_t _outstanding = 0;
+    // Textures whose image has yet to be uploaded, touched only on the GL thread
+    std::unordered_set<GLuint> _pending;
+    bool _stopping = false;
+
+    std::mutex _mutex;
+    std::condition_variable _requestAvailable;
+    std::condition_variable _readySpace;
+    std::condition_variable _readyAvailable;
+
+    void DecoderLoop() {
+        for (;;) {
+            PendingTexture request;
+
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _requestAvailable.wait(lock, [this] { return _stopping || !_requests.empty(); });
+
+                if (_stopping) {
+                    return;
+                }
+
+                request = std::move(_requests.front());
+                _requests.pop_front();
+            }
+
+            DecodedTexture decoded{request.TextureId, PrepareTexture(request.Path, request.Type, request.Settings)};
+
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _readySpace.wait(lock, [this] { return _stopping || _ready.size() < _readyCapacity; });
+
+                if (_stopping) {
+                    return;
+                }
+
+                _ready.push_back(std::move(decoded));
+            }
+
+            _readyAvailable.notify_one();
+        }
+    }
+
+    bool PopReady(DecodedTexture &decoded, bool wait) {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        if (wait) {
+            _readyAvailable.wait(lock, [this] { return !_ready.empty(); });
+        } else if (_ready.empty()) {
+            return false;
+        }
+
+        decoded = std::move(_ready.front());
+        _ready.pop_front();
+        lock.unlock();
+
+        _readySpace.notify_one();
+        return true;
+    }
+
+    void Upload(const DecodedTexture &decoded) {
+        UploadPreparedTexture(decoded.TextureId, decoded.Texture);
+        _pending.erase(decoded.TextureId);
+        --_outstanding;
+    }
+
+public:
+    static size_t DefaultDecoderCount() { return std::clamp(std::thread::hardware_concurrency(), 1u, 4u); }
+
+    AsyncTextureLoader(size_t decoderCount = DefaultDecoderCount(), size_t readyCapacity = 4) :
+        _readyCapacity(std::max<size_t>(readyCapacity, 1)) {
+        _decoders.reserve(decoderCount);
+
+        for (size_t i = 0; i < decoderCount; ++i) {
+            _decoders.emplace_back([this] { DecoderLoop(); });
+        }
+    }
+
+    AsyncTextureLoader(const AsyncTextureLoader &) = delete;
+    AsyncTextureLoader &operator=(const AsyncTextureLoader &) = delete;
+
+    ~AsyncTextureLoader() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _requestAvailable.notify_all();
+        _readySpace.notify_all();
+
+        for (std::thread &decoder : _decoders) {
+            decoder.join();
+        }
+    }
+
+    /**
+     * Creates the texture with a placeholder texel and queues the file for preparation. Must run on the GL thread.
+     */
+    GLuint
+    Request(const std::string &path, const std::string &type, const TextureSettings &settings = TextureSettings()) {
+        GLuint textureId;
+        glGenTextures(1, &textureId);
+        UploadPlaceholder(textureId, PlaceholderColor(type));
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _requests.push_back({textureId, path, type, settings});
+        }
+        _requestAvailable.notify_one();
+
+        _pending.insert(textureId);
+        ++_outstanding;
+        return textureId;
+    }
+
+    /**
+     * Uploads decoded images until the queue is empty or `budgetMilliseconds` has been spent. At least one image is
+     * uploaded whenever one is ready, so a tight budget still makes progress. Returns the number uploaded.
+     */
+    size_t ProcessUploads(float budgetMilliseconds) {
+        using Clock = std::chrono::steady_clock;
+
+        const Clock::time_point start = Clock::now();
+        const std::chrono::duration<float, std::milli> budget(budgetMilliseconds);
+        size_t uploaded = 0;
+        DecodedTexture decoded;
+
+        while (PopReady(decoded, false)) {
+            Upload(decoded);
+            ++uploaded;
+
+            if (Clock::now() - start >= budget) {
+                break;
+            }
+        }
+
+        return uploaded;
+    }
+
+    /**
+     * Blocks until every requested texture has been decoded and uploaded.
+     */
+    void Finish() {
+        DecodedTexture decoded;
+
+        while (_outstanding > 0) {
+            PopReady(decoded, true);
+            Upload(decoded);
+        }
+    }
+
+    size_t Outstanding() const { return _outstanding; }
+
+    // Whether `textureId` still has an upload coming, so deleting it now would let that upload land on a reused name
+    bool IsPending(GLuint textureId) const { return _pending.count(textureId) != 0; }
+
+    bool IsIdle() const { return _outstanding == 0; }
+};
+} // namespace Textures
+
+#endif
@@ -0,0 +1,251 @@
+/**
+ * @file CPU encoders for the BC1, BC3 and BC5 block-compressed texture formats.
+ *
+ * Every format works on 4x4 blocks of RGBA8 texels. BC1 stores colour as two RGB565 endpoints plus a 2-bit index per
+ * texel; BC3 adds a BC4 block for alpha; BC5 is two BC4 blocks holding only red and green, which is all a unit
+ * tangent-space normal needs. Endpoints come from the block's bounding box, inset slightly and oriented along the
+ * dominant colour diagonal, which is fast and close enough in quality for an offline bake.
+ */
+
+#ifndef TEXTURES_BLOCK_COMPRESSION_H
+#define TEXTURES_BLOCK_COMPRESSION_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "openGLCommon.hpp"
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace Textures {
+enum class BlockFormat : uint32_t { BC1 = 1, BC3 = 3, BC5 = 5 };
+
+inline GLenum InternalFormatFor(BlockFormat format) {
+    switch (format) {
+    case BlockFormat::BC1:
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case BlockFormat::BC3:
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case BlockFormat::BC5:
+        return GL_COMPRESSED_RG_RGTC2;
+    }
+
+    return 0;
+}
+
+inline size_t BlockBytes(BlockFormat format) { return format == BlockFormat::BC1 ? 8 : 16; }
+
+inline size_t CompressedSize(BlockFormat format, GLsizei width, GLsizei height) {
+    const size_t blocksWide = (std::max(width, 1) + 3) / 4;
+    const size_t blocksHigh = (std::max(height, 1) + 3) / 4;
+
+    return blocksWide * blocksHigh * BlockBytes(format);
+}
+
+namespace BlockCompression {
+inline uint16_t PackRGB565(const unsigned char *rgb) {
+    return static_cast<uint16_t>(((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3));
+}
+
+inline void UnpackRGB565(uint16_t color, int *rgb) {
+    const int r = (color >> 11) & 31;
+    const int g = (color >> 5) & 63;
+    const int b = color & 31;
+
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+/**
+ * Encodes 16 RGBA texels into an 8-byte BC1 colour block, always in four-colour mode so it is also valid inside BC3.
+ */
+inline void EncodeColorBlock(const unsigned char *texels, unsigned char *block) {
+    unsigned char minimum[3] = {255, 255, 255};
+    unsigned char maximum[3] = {0, 0, 0};
+    int mean[3] = {0, 0, 0};
+
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            minimum[c] = std::min(minimum[c], texels[i * 4 + c]);
+            maximum[c] = std::max(maximum[c], texels[i * 4 + c]);
+            mean[c] += texels[i * 4 + c];
+        }
+    }
+
+    // The bounding box has four diagonals; pick the one red and blue vary along relative to green
+    int covarianceRG = 0;
+    int covarianceBG = 0;
+
+    for (int i = 0; i < 16; ++i) {
+        const int g = texels[i * 4 + 1] * 16 - mean[1];
+        covarianceRG += (texels[i * 4 + 0] * 16 - mean[0]) * g;
+        covarianceBG += (texels[i * 4 + 2] * 16 - mean[2]) * g;
+    }
+
+    if (covarianceRG < 0) {
+        std::swap(minimum[0], maximum[0]);
+    }
+    if (covarianceBG < 0) {
+        std::swap(minimum[2], maximum[2]);
+    }
+
+    // Pull the endpoints in by 1/16 of the range so the interpolated colours land inside the cluster
+    for (int c = 0; c < 3; ++c) {
+        const int inset = (maximum[c] - minimum[c]) / 16;
+        maximum[c] = static_cast<unsigned char>(maximum[c] - inset);
+        minimum[c] = static_cast<unsigned char>(minimum[c] + inset);
+    }
+
+    uint16_t color0 = PackRGB565(maximum);
+    uint16_t color1 = PackRGB565(minimum);
+
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+
+    uint32_t indices = 0;
+
+    if (color0 != color1) {
+        int palette[4][3];
+        UnpackRGB565(color0, palette[0]);
+        UnpackRGB565(color1, palette[1]);
+
+        for (int c = 0; c < 3; ++c) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (int i = 0; i < 16; ++i) {
+            int bestIndex = 0;
+            int bestDistance = 1 << 30;
+
+            for (int p = 0; p < 4; ++p) {
+                int distance = 0;
+
+                for (int c = 0; c < 3; ++c) {
+                    const int delta = texels[i * 4 + c] - palette[p][c];
+                    distance += delta * delta;
+                }
+
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    bestIndex = p;
+                }
+            }
+
+            indices |= static_cast<uint32_t>(bestIndex) << (i * 2);
+        }
+    }
+
+    block[0] = static_cast<unsigned char>(color0 & 0xFF);
+    block[1] = static_cast<unsigned char>(color0 >> 8);
+    block[2] = static_cast<unsigned char>(color1 & 0xFF);
+    block[3] = static_cast<unsigned char>(color1 >> 8);
+
+    for (int i = 0; i < 4; ++i) {
+        block[4 + i] = static_cast<unsigned char>(indices >> (i * 8));
+    }
+}
+
+/**
+ * Encodes one channel of 16 RGBA texels into an 8-byte BC4 block using the eight-value interpolation mode.
+ */
+inline void EncodeChannelBlock(const unsigned char *texels, int channel, unsigned char *block) {
+    unsigned char minimum = 255;
+    unsigned char maximum = 0;
+
+    for (int i = 0; i < 16; ++i) {
+        minimum = std::min(minimum, texels[i * 4 + channel]);
+        maximum = std::max(maximum, texels[i * 4 + channel]);
+    }
+
+    uint64_t indices = 0;
+
+    if (maximum != minimum) {
+        int palette[8];
+        palette[0] = maximum;
+        palette[1] = minimum;
+
+        for (int p = 1; p < 7; ++p) {
+            palette[p + 1] = ((7 - p) * maximum + p * minimum) / 7;
+        }
+
+        for (int i = 0; i < 16; ++i) {
+            int bestIndex = 0;
+            int bestDistance = 256;
+
+            for (int p = 0; p < 8; ++p) {
+                const int distance = std::abs(texels[i * 4 + channel] - palette[p]);
+
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    bestIndex = p;
+                }
+            }
+
+            indices |= static_cast<uint64_t>(bestIndex) << (i * 3);
+        }
+    }
+
+    block[0] = maximum;
+    block[1] = minimum;
+
+    for (int i = 0; i < 6; ++i) {
+        block[2 + i] = static_cast<unsigned char>(indices >> (i * 8));
+    }
+}
+} // namespace BlockCompression
+
+/**
+ * Compresses a whole RGBA8 image. Partial blocks at the right and bottom edges repeat their last texel.
+ */
+inline std::vector<unsigned char>
+CompressImage(BlockFormat format, const unsigned char *rgba, GLsizei width, GLsizei height) {
+    std::vector<unsigned char> compressed(CompressedSize(format, width, height));
+    unsigned char *block = compressed.data();
+    unsigned char texels[16 * 4];
+
+    for (GLsizei blockY = 0; blockY < height; blockY += 4) {
+        for (GLsizei blockX = 0; blockX < width; blockX += 4) {
+            for (int y = 0; y < 4; ++y) {
+                for (int x = 0; x < 4; ++x) {
+                    const size_t sourceX = std::min(blockX + x, width - 1);
+                    const size_t sourceY = std::min(blockY + y, height - 1);
+                    const unsigned char *texel = rgba + (sourceY * width + sourceX) * 4;
+
+                    std::copy(texel, texel + 4, texels + (y * 4 + x) * 4);
+                }
+            }
+
+            switch (format) {
+            case BlockFormat::BC1:
+                BlockCompression::EncodeColorBlock(texels, block);
+                break;
+            case BlockFormat::BC3:
+                BlockCompression::EncodeChannelBlock(texels, 3, block);
+                BlockCompression::EncodeColorBlock(texels, block + 8);
+                break;
+            case BlockFormat::BC5:
+                BlockCompression::EncodeChannelBlock(texels, 0, block);
+                BlockCompression::EncodeChannelBlock(texels, 1, block + 8);
+                break;
+            }
+
+            block += BlockBytes(format);
+        }
+    }
+
+    return compressed;
+}
+} // namespace Textures
+
+#endif
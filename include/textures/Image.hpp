@@ -0,0 +1,111 @@
+/**
+ * @file Decoding images from disk and uploading them into GL textures
+ */
+
+#ifndef TEXTURES_IMAGE_H
+#define TEXTURES_IMAGE_H
+
+#include <memory>
+#include <string>
+
+#include <glm/glm.hpp>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "render/StateCache.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Textures {
+struct StbiImageDeleter {
+    void operator()(unsigned char *data) { stbi_image_free(data); }
+};
+
+struct Image {
+    std::string Path;
+    GLint Width = 0;
+    GLint Height = 0;
+    // Channels per texel in `Data`
+    GLint Components = 0;
+    // Channels stored in the file, which differs from `Components` when a channel count was forced on decode
+    GLint SourceComponents = 0;
+    std::unique_ptr<unsigned char, StbiImageDeleter> Data;
+};
+
+/**
+ * Decodes an image flipped for GL's bottom-up convention, optionally forcing `desiredComponents` channels. Safe to
+ * call from any thread; `Data` is empty on failure.
+ */
+inline Image DecodeImage(const std::string &path, GLint desiredComponents = 0) {
+    Image image;
+    image.Path = path;
+
+    stbi_set_flip_vertically_on_load_thread(true);
+    image.Data.reset(
+        stbi_load(path.c_str(), &image.Width, &image.Height, &image.SourceComponents, desiredComponents)
+    );
+    image.Components = desiredComponents ? desiredComponents : image.SourceComponents;
+
+    return image;
+}
+
+inline GLenum FormatFor(GLint components) {
+    switch (components) {
+    case 1:
+        return GL_RED;
+    case 2:
+        return GL_RG;
+    case 4:
+        return GL_RGBA;
+    default:
+        return GL_RGB;
+    }
+}
+
+inline void SetTextureParameters() {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+/**
+ * Replaces the contents of `textureId` with a decoded image and builds its mip chain. Must run on the GL thread.
+ */
+inline void UploadImage(GLuint textureId, const Image &image) {
+    const GLenum format = FormatFor(image.Components);
+
+    Render::StateCache::Shared().BindTexture(textureId);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, image.Width, image.Height, 0, format, GL_UNSIGNED_BYTE, image.Data.get());
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    SetTextureParameters();
+}
+
+/**
+ * Gives `textureId` a single texel of `color`, so it can be sampled before its real image has been decoded.
+ */
+inline void UploadPlaceholder(GLuint textureId, const glm::u8vec4 &color) {
+    Render::StateCache::Shared().BindTexture(textureId);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &color);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    SetTextureParameters();
+}
+
+/**
+ * A neutral stand-in for each texture type: mid grey albedo, no specular, and a flat tangent-space normal.
+ */
+inline glm::u8vec4 PlaceholderColor(const std::string &type) {
+    if (type == "texture_specular") {
+        return glm::u8vec4(0, 0, 0, 255);
+    } else if (type == "texture_normal") {
+        return glm::u8vec4(128, 128, 255, 255);
+    }
+
+    return glm::u8vec4(128, 128, 128, 255);
+}
+} // namespace Textures
+
+#endif
@@ -0,0 +1,416 @@
+/**
+ * @file Builds mip chains on the CPU, as an alternative to `glGenerateMipmap`.
+ *
+ * Two filters are available. `Box` averages each 2x2 footprint; with plain 8-bit data it runs as an SSE2 integer
+ * kernel that produces two output texels per iteration. `Kaiser` is a separable 8-tap Kaiser-windowed sinc, which keeps
+ * fine detail sharper across levels at a higher cost. Either filter can average colour in linear light by decoding
+ * sRGB first, which stops dark texels from bleeding into bright ones as the chain shrinks; alpha and any image with
+ * fewer than three channels are always treated as linear.
+ *
+ * Rows of each level are independent, so they are split across a thread pool when one is given.
+ */
+
+#ifndef TEXTURES_MIP_CHAIN_H
+#define TEXTURES_MIP_CHAIN_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTURES_MIP_CHAIN_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "threading/ThreadPool.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Textures {
+enum class MipFilter { Box, Kaiser };
+
+struct MipOptions {
+    MipFilter Filter = MipFilter::Box;
+    // Average colour channels in linear light; only meaningful for sRGB-encoded images such as diffuse maps
+    bool SRGB = false;
+    // Splits each level's rows across this pool when set; otherwise the calling thread does all the work
+    Threading::ThreadPool *Pool = nullptr;
+};
+
+struct MipLevel {
+    GLsizei Width;
+    GLsizei Height;
+    std::vector<unsigned char> Pixels;
+};
+
+namespace MipChain {
+// Also the most taps any kernel may have
+constexpr int KAISER_TAPS = 8;
+constexpr float KAISER_ALPHA = 4.0f;
+constexpr int SRGB_ENCODE_TABLE_SIZE = 16384;
+constexpr GLsizei ROWS_PER_TASK = 16;
+
+// Read-only view of a level, so the base image can be filtered without copying it into a MipLevel
+struct LevelView {
+    const unsigned char *Pixels;
+    GLsizei Width;
+    GLsizei Height;
+};
+
+inline LevelView ViewOf(const MipLevel &level) { return {level.Pixels.data(), level.Width, level.Height}; }
+
+struct Kernel {
+    // Offset of the first tap from 2 * destination texel, in source texels
+    int FirstOffset;
+    std::vector<float> Weights;
+};
+
+inline float SRGBToLinear(float value) {
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+inline float LinearToSRGB(float value) {
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+inline const std::array<float, 256> &SRGBDecodeTable() {
+    static const std::array<float, 256> table = [] {
+        std::array<float, 256> result;
+
+        for (int i = 0; i < 256; ++i) {
+            result[i] = SRGBToLinear(i / 255.0f);
+        }
+
+        return result;
+    }();
+
+    return table;
+}
+
+inline const std::array<unsigned char, SRGB_ENCODE_TABLE_SIZE> &SRGBEncodeTable() {
+    static const std::array<unsigned char, SRGB_ENCODE_TABLE_SIZE> table = [] {
+        std::array<unsigned char, SRGB_ENCODE_TABLE_SIZE> result;
+
+        for (int i = 0; i < SRGB_ENCODE_TABLE_SIZE; ++i) {
+            const float linear = i / static_cast<float>(SRGB_ENCODE_TABLE_SIZE - 1);
+            result[i] = static_cast<unsigned char>(LinearToSRGB(linear) * 255.0f + 0.5f);
+        }
+
+        return result;
+    }();
+
+    return table;
+}
+
+/**
+ * Zeroth-order modified Bessel function of the first kind, by its power series.
+ */
+inline double BesselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+
+    for (int k = 1; k < 32; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+inline Kernel BoxKernel() { return {0, {0.5f, 0.5f}}; }
+
+/**
+ * Weights for halving with a Kaiser-windowed sinc. A destination texel's centre sits half a texel past its first
+ * source texel, so the taps are symmetric around 2x + 0.5 and the same for every texel.
+ */
+inline Kernel KaiserKernel() {
+    static const Kernel kernel = [] {
+        Kernel result{1 - KAISER_TAPS / 2, std::vector<float>(KAISER_TAPS)};
+        const double radius = KAISER_TAPS / 2.0;
+        const double pi = 3.14159265358979323846;
+        double sum = 0.0;
+
+        for (int t = 0; t < KAISER_TAPS; ++t) {
+            const double distance = result.FirstOffset + t - 0.5;
+            const double x = distance / 2.0;
+            const double sinc = x == 0.0 ? 1.0 : std::sin(pi * x) / (pi * x);
+            const double window = distance / radius;
+            const double kaiser = BesselI0(KAISER_ALPHA * std::sqrt(std::max(0.0, 1.0 - window * window))) /
+                                  BesselI0(KAISER_ALPHA);
+
+            result.Weights[t] = static_cast<float>(sinc * kaiser);
+            sum += result.Weights[t];
+        }
+
+        for (float &weight : result.Weights) {
+            weight = static_cast<float>(weight / sum);
+        }
+
+        return result;
+    }();
+
+    return kernel;
+}
+
+#ifdef TEXTURES_MIP_CHAIN_SSE2
+using Texel = __m128;
+
+inline Texel TexelZero() { return _mm_setzero_ps(); }
+
+inline Texel TexelMultiplyAdd(Texel sum, Texel value, float weight) {
+    return _mm_add_ps(sum, _mm_mul_ps(value, _mm_set1_ps(weight)));
+}
+
+inline void TexelStore(Texel value, float *destination) { _mm_storeu_ps(destination, value); }
+
+inline Texel TexelLoad(const float *source) { return _mm_loadu_ps(source); }
+#else
+struct Texel {
+    float Channels[4];
+};
+
+inline Texel TexelZero() { return {{0.0f, 0.0f, 0.0f, 0.0f}}; }
+
+inline Texel TexelMultiplyAdd(Texel sum, Texel value, float weight) {
+    for (int c = 0; c < 4; ++c) {
+        sum.Channels[c] += value.Channels[c] * weight;
+    }
+
+    return sum;
+}
+
+inline void TexelStore(Texel value, float *destination) { std::copy(value.Channels, value.Channels + 4, destination); }
+
+inline Texel TexelLoad(const float *source) { return {{source[0], source[1], source[2], source[3]}}; }
+#endif
+
+/**
+ * Converts a row of `components` 8-bit channels per texel to four floats per texel in [0, 1], decoding sRGB colour
+ * when asked. Missing channels are zero.
+ */
+inline void DecodeRow(const unsigned char *texels, GLsizei width, GLint components, bool srgb, float *destination) {
+    const std::array<float, 256> &decode = SRGBDecodeTable();
+    const GLint colorChannels = srgb ? std::min(components, 3) : 0;
+
+    for (GLsizei x = 0; x < width; ++x, texels += components, destination += 4) {
+        GLint c = 0;
+
+        for (; c < colorChannels; ++c) {
+            destination[c] = decode[texels[c]];
+        }
+        for (; c < components; ++c) {
+            destination[c] = texels[c] * (1.0f / 255.0f);
+        }
+        for (; c < 4; ++c) {
+            destination[c] = 0.0f;
+        }
+    }
+}
+
+inline void EncodeTexel(Texel value, GLint components, bool srgb, unsigned char *texel) {
+    const std::array<unsigned char, SRGB_ENCODE_TABLE_SIZE> &encode = SRGBEncodeTable();
+    float channels[4];
+    TexelStore(value, channels);
+
+    for (GLint c = 0; c < components; ++c) {
+        const float channel = std::clamp(channels[c], 0.0f, 1.0f);
+
+        if (srgb && c < 3) {
+            texel[c] = encode[static_cast<int>(channel * (SRGB_ENCODE_TABLE_SIZE - 1) + 0.5f)];
+        } else {
+            texel[c] = static_cast<unsigned char>(channel * 255.0f + 0.5f);
+        }
+    }
+}
+
+/**
+ * Plain 8-bit 2x2 average of destination rows [firstRow, lastRow).
+ */
+inline void DownsampleBoxRows(
+    const LevelView &source, MipLevel &level, GLint components, GLsizei firstRow, GLsizei lastRow
+) {
+    const size_t sourceStride = static_cast<size_t>(source.Width) * components;
+    const size_t levelStride = static_cast<size_t>(level.Width) * components;
+
+    for (GLsizei y = firstRow; y < lastRow; ++y) {
+        const unsigned char *row0 = &source.Pixels[std::min(y * 2, source.Height - 1) * sourceStride];
+        const unsigned char *row1 = &source.Pixels[std::min(y * 2 + 1, source.Height - 1) * sourceStride];
+        unsigned char *destination = &level.Pixels[y * levelStride];
+        GLsizei x = 0;
+
+#ifdef TEXTURES_MIP_CHAIN_SSE2
+        if (components == 4 && source.Width > 1) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i rounding = _mm_set1_epi16(2);
+
+            // Four source texels from each row make two destination texels
+            for (; x + 2 <= level.Width; x += 2) {
+                const __m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + x * 8));
+                const __m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + x * 8));
+
+                const __m128i left = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+                const __m128i right = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+
+                const __m128i leftSum = _mm_add_epi16(left, _mm_srli_si128(left, 8));
+                const __m128i rightSum = _mm_add_epi16(right, _mm_srli_si128(right, 8));
+
+                __m128i average = _mm_unpacklo_epi64(leftSum, rightSum);
+                average = _mm_srli_epi16(_mm_add_epi16(average, rounding), 2);
+
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(destination + x * 4), _mm_packus_epi16(average, zero));
+            }
+        }
+#endif
+
+        for (; x < level.Width; ++x) {
+            const size_t x0 = static_cast<size_t>(std::min(x * 2, source.Width - 1)) * components;
+            const size_t x1 = static_cast<size_t>(std::min(x * 2 + 1, source.Width - 1)) * components;
+
+            for (GLint c = 0; c < components; ++c) {
+                const int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                destination[x * components + c] = static_cast<unsigned char>((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+/**
+ * Separable filtered downsample of destination rows [firstRow, lastRow) in floating point. The source rows this band
+ * touches are decoded once up front, then each destination row is filtered vertically into a scratch row at source
+ * width and horizontally into the level.
+ */
+inline void DownsampleFilteredRows(
+    const LevelView &source,
+    MipLevel &level,
+    GLint components,
+    const Kernel &kernel,
+    bool srgb,
+    GLsizei firstRow,
+    GLsizei lastRow
+) {
+    const size_t sourceStride = static_cast<size_t>(source.Width) * components;
+    const size_t levelStride = static_cast<size_t>(level.Width) * components;
+    const size_t floatStride = static_cast<size_t>(source.Width) * 4;
+    const int taps = static_cast<int>(kernel.Weights.size());
+
+    const GLsizei firstSourceRow = std::max(firstRow * 2 + kernel.FirstOffset, 0);
+    const GLsizei lastSourceRow = std::min((lastRow - 1) * 2 + kernel.FirstOffset + taps - 1, source.Height - 1);
+
+    std::vector<float> decoded(static_cast<size_t>(lastSourceRow - firstSourceRow + 1) * floatStride);
+    std::vector<float> scratch(floatStride);
+
+    for (GLsizei row = firstSourceRow; row <= lastSourceRow; ++row) {
+        DecodeRow(
+            &source.Pixels[row * sourceStride],
+            source.Width,
+            components,
+            srgb,
+            &decoded[(row - firstSourceRow) * floatStride]
+        );
+    }
+
+    for (GLsizei y = firstRow; y < lastRow; ++y) {
+        const float *rows[KAISER_TAPS];
+
+        for (int t = 0; t < taps; ++t) {
+            const GLsizei row = std::clamp(y * 2 + kernel.FirstOffset + t, firstSourceRow, lastSourceRow);
+            rows[t] = &decoded[(row - firstSourceRow) * floatStride];
+        }
+
+        for (size_t x = 0; x < floatStride; x += 4) {
+            Texel sum = TexelZero();
+
+            for (int t = 0; t < taps; ++t) {
+                sum = TexelMultiplyAdd(sum, TexelLoad(rows[t] + x), kernel.Weights[t]);
+            }
+
+            TexelStore(sum, &scratch[x]);
+        }
+
+        unsigned char *destination = &level.Pixels[y * levelStride];
+
+        for (GLsizei x = 0; x < level.Width; ++x) {
+            Texel sum = TexelZero();
+
+            for (int t = 0; t < taps; ++t) {
+                const GLsizei column = std::clamp(x * 2 + kernel.FirstOffset + t, 0, source.Width - 1);
+                sum = TexelMultiplyAdd(sum, TexelLoad(&scratch[static_cast<size_t>(column) * 4]), kernel.Weights[t]);
+            }
+
+            EncodeTexel(sum, components, srgb, destination + static_cast<size_t>(x) * components);
+        }
+    }
+}
+} // namespace MipChain
+
+/**
+ * Halves one level of `components` 8-bit channels per texel.
+ */
+inline MipLevel
+Downsample(const MipChain::LevelView &source, GLint components, const MipOptions &options = MipOptions()) {
+    MipLevel level;
+    level.Width = std::max(source.Width / 2, 1);
+    level.Height = std::max(source.Height / 2, 1);
+    level.Pixels.resize(static_cast<size_t>(level.Width) * level.Height * components);
+
+    const bool srgb = options.SRGB && components >= 3;
+    const bool filtered = srgb || options.Filter != MipFilter::Box;
+    const MipChain::Kernel kernel = options.Filter == MipFilter::Kaiser ? MipChain::KaiserKernel()
+                                                                        : MipChain::BoxKernel();
+
+    auto downsampleRows = [&](GLsizei firstRow, GLsizei lastRow) {
+        if (filtered) {
+            MipChain::DownsampleFilteredRows(source, level, components, kernel, srgb, firstRow, lastRow);
+        } else {
+            MipChain::DownsampleBoxRows(source, level, components, firstRow, lastRow);
+        }
+    };
+
+    // Work in bands even on one thread, which bounds the filtered path's scratch memory
+    const size_t bands = (level.Height + MipChain::ROWS_PER_TASK - 1) / MipChain::ROWS_PER_TASK;
+
+    auto downsampleBand = [&](size_t band) {
+        const GLsizei firstRow = static_cast<GLsizei>(band) * MipChain::ROWS_PER_TASK;
+        downsampleRows(firstRow, std::min(firstRow + MipChain::ROWS_PER_TASK, level.Height));
+    };
+
+    if (options.Pool && bands > 1) {
+        options.Pool->ParallelFor(bands, downsampleBand);
+    } else {
+        for (size_t band = 0; band < bands; ++band) {
+            downsampleBand(band);
+        }
+    }
+
+    return level;
+}
+
+/**
+ * Returns every level below the base image, from half size down to 1x1. The base itself is not copied.
+ */
+inline std::vector<MipLevel> BuildMipLevels(
+    const unsigned char *pixels,
+    GLsizei width,
+    GLsizei height,
+    GLint components,
+    const MipOptions &options = MipOptions()
+) {
+    std::vector<MipLevel> levels;
+
+    if (width <= 1 && height <= 1) {
+        return levels;
+    }
+
+    levels.push_back(Downsample({pixels, width, height}, components, options));
+
+    while (levels.back().Width > 1 || levels.back().Height > 1) {
+        MipLevel next = Downsample(MipChain::ViewOf(levels.back()), components, options);
+        levels.push_back(std::move(next));
+    }
+
+    return levels;
+}
+} // namespace Textures
+
+#endif
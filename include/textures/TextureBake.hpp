@@ -0,0 +1,302 @@
+/**
+ * @file Offline bake of textures into block-compressed mip chains.
+ *
+ * A baked texture sits next to its source as `<source>.btex`, a small KTX-like container:
+ *
+ *   header | level 0 header | level 0 blocks | level 1 header | level 1 blocks | ...
+ *
+ * Diffuse and specular maps bake to BC1, or BC3 when they carry alpha; normal maps bake to BC5. The bake is redone
+ * whenever the container version, source file hash, block format or mip settings no longer match.
+ */
+
+#ifndef TEXTURES_TEXTURE_BAKE_H
+#define TEXTURES_TEXTURE_BAKE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cache/MappedFile.hpp"
+#include "cache/ModelCache.hpp"
+#include "render/StateCache.hpp"
+#include "textures/BlockCompression.hpp"
+#include "textures/Image.hpp"
+#include "textures/MipChain.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Textures {
+constexpr char BAKED_TEXTURE_MAGIC[8] = {'L', 'O', 'G', 'L', 'B', 'T', 'X', '\0'};
+constexpr uint32_t BAKED_TEXTURE_VERSION = 2;
+
+struct BakedTextureHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t format;
+    uint64_t sourceHash;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    // The mip filter and sRGB flag the chain was built with, see `MipSettingsKey`
+    uint32_t mipSettings;
+};
+
+struct BakedLevelHeader {
+    uint32_t width;
+    uint32_t height;
+    uint32_t byteSize;
+};
+
+struct CompressedLevel {
+    GLsizei Width;
+    GLsizei Height;
+    std::vector<unsigned char> Blocks;
+};
+
+struct CompressedImage {
+    std::string Path;
+    BlockFormat Format = BlockFormat::BC1;
+    std::vector<CompressedLevel> Levels;
+};
+
+inline std::string BakedTexturePath(const std::string &sourcePath) { return sourcePath + ".btex"; }
+
+/**
+ * Block compression needs S3TC for BC1/BC3; BC5 (RGTC) is core since GL 3.0. Must run with a current context.
+ */
+inline bool SupportsBlockCompression() { return glfwExtensionSupported("GL_EXT_texture_compression_s3tc"); }
+
+inline BlockFormat BlockFormatFor(const std::string &type, GLint components) {
+    if (type == "texture_normal") {
+        return BlockFormat::BC5;
+    }
+
+    return components == 4 ? BlockFormat::BC3 : BlockFormat::BC1;
+}
+
+/**
+ * The format `BakeTexture` would pick for the source, from its header alone so a cache hit still avoids decoding it.
+ */
+inline BlockFormat ExpectedBlockFormat(const std::string &sourcePath, const std::string &type) {
+    int width = 0;
+    int height = 0;
+    int components = 0;
+
+    if (!stbi_info(sourcePath.c_str(), &width, &height, &components)) {
+        components = 0;
+    }
+
+    return BlockFormatFor(type, components);
+}
+
+// Levels in a full chain from `width` by `height` down to 1x1
+inline uint32_t MaxMipLevels(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+
+    for (uint32_t extent = std::max(width, height); extent > 1; extent /= 2) {
+        ++levels;
+    }
+
+    return levels;
+}
+
+inline uint32_t MipSettingsKey(const MipOptions &options) {
+    return static_cast<uint32_t>(options.Filter) << 1 | (options.SRGB ? 1u : 0u);
+}
+
+/**
+ * Reads a bake only if it was made from this source, with these mip settings, into the block format `expected`.
+ */
+inline bool ReadBakedTexture(
+    const std::string &path, uint64_t sourceHash, BlockFormat expected, const MipOptions &mips, CompressedImage &image
+) {
+    Cache::MappedFile file(path);
+
+    if (!file.IsOpen()) {
+        return false;
+    }
+
+    const unsigned char *data = file.Data();
+    const size_t size = file.Size();
+    size_t offset = sizeof(BakedTextureHeader);
+
+    BakedTextureHeader header;
+
+    if (size < offset) {
+        return false;
+    }
+
+    std::memcpy(&header, data, sizeof(header));
+
+    if (std::memcmp(header.magic, BAKED_TEXTURE_MAGIC, sizeof(header.magic)) ||
+        header.version != BAKED_TEXTURE_VERSION || header.sourceHash != sourceHash ||
+        header.format != static_cast<uint32_t>(expected) || header.mipSettings != MipSettingsKey(mips) ||
+        header.levelCount > MaxMipLevels(header.width, header.height)) {
+        return false;
+    }
+
+    image.Format = static_cast<BlockFormat>(header.format);
+    image.Levels.clear();
+    image.Levels.reserve(header.levelCount);
+
+    for (uint32_t i = 0; i < header.levelCount; ++i) {
+        BakedLevelHeader level;
+
+        if (sizeof(level) > size - offset) {
+            return false;
+        }
+
+        std::memcpy(&level, data + offset, sizeof(level));
+        offset += sizeof(level);
+
+        if (level.byteSize > size - offset ||
+            level.byteSize != CompressedSize(image.Format, level.width, level.height)) {
+            return false;
+        }
+
+        image.Levels.push_back(
+            {static_cast<GLsizei>(level.width),
+             static_cast<GLsizei>(level.height),
+             std::vector<unsigned char>(data + offset, data + offset + level.byteSize)}
+        );
+        offset += level.byteSize;
+    }
+
+    return !image.Levels.empty();
+}
+
+inline bool WriteBakedTexture(
+    const std::string &path, uint64_t sourceHash, const MipOptions &mips, const CompressedImage &image
+) {
+    const std::string temporaryPath = path + ".tmp";
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+    if (!file) {
+        std::cout << "ERROR::TEXTURE_BAKE::WRITE_FAILED\npath: " << path << std::endl;
+        return false;
+    }
+
+    BakedTextureHeader header;
+    std::memcpy(header.magic, BAKED_TEXTURE_MAGIC, sizeof(header.magic));
+    header.version = BAKED_TEXTURE_VERSION;
+    header.format = static_cast<uint32_t>(image.Format);
+    header.sourceHash = sourceHash;
+    header.width = static_cast<uint32_t>(image.Levels[0].Width);
+    header.height = static_cast<uint32_t>(image.Levels[0].Height);
+    header.levelCount = static_cast<uint32_t>(image.Levels.size());
+    header.mipSettings = MipSettingsKey(mips);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    for (const CompressedLevel &level : image.Levels) {
+        BakedLevelHeader levelHeader = {
+            static_cast<uint32_t>(level.Width),
+            static_cast<uint32_t>(level.Height),
+            static_cast<uint32_t>(level.Blocks.size())
+        };
+        file.write(reinterpret_cast<const char *>(&levelHeader), sizeof(levelHeader));
+        file.write(reinterpret_cast<const char *>(level.Blocks.data()), level.Blocks.size());
+    }
+
+    file.close();
+
+    std::error_code error;
+
+    if (file) {
+        std::filesystem::rename(temporaryPath, path, error);
+    }
+
+    if (!file || error) {
+        std::cout << "ERROR::TEXTURE_BAKE::WRITE_FAILED\npath: " << path << std::endl;
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Decodes the source, builds its mip chain and compresses every level.
+ */
+inline bool
+BakeTexture(const std::string &sourcePath, const std::string &type, const MipOptions &mips, CompressedImage &image) {
+    Image source = DecodeImage(sourcePath, 4);
+
+    if (!source.Data) {
+        return false;
+    }
+
+    image.Format = BlockFormatFor(type, source.SourceComponents);
+    image.Levels.clear();
+    image.Levels.push_back(
+        {source.Width,
+         source.Height,
+         CompressImage(image.Format, source.Data.get(), source.Width, source.Height)}
+    );
+
+    for (const MipLevel &level : BuildMipLevels(source.Data.get(), source.Width, source.Height, 4, mips)) {
+        image.Levels.push_back(
+            {level.Width, level.Height, CompressImage(image.Format, level.Pixels.data(), level.Width, level.Height)}
+        );
+    }
+
+    return true;
+}
+
+/**
+ * Returns the baked form of `sourcePath`, baking and writing it first if the cached copy is missing or stale. Safe to
+ * call from worker threads. `Levels` is empty on failure.
+ */
+inline CompressedImage
+LoadOrBakeTexture(const std::string &sourcePath, const std::string &type, const MipOptions &mips = MipOptions()) {
+    CompressedImage image;
+    image.Path = sourcePath;
+
+    const std::string bakedPath = BakedTexturePath(sourcePath);
+    const uint64_t sourceHash = Cache::HashFile(sourcePath);
+
+    if (ReadBakedTexture(bakedPath, sourceHash, ExpectedBlockFormat(sourcePath, type), mips, image)) {
+        return image;
+    }
+
+    if (BakeTexture(sourcePath, type, mips, image)) {
+        WriteBakedTexture(bakedPath, sourceHash, mips, image);
+    }
+
+    return image;
+}
+
+/**
+ * Uploads every baked level with `glCompressedTexImage2D`. Must run on the GL thread.
+ */
+inline void UploadCompressedImage(GLuint textureId, const CompressedImage &image) {
+    const GLenum internalFormat = InternalFormatFor(image.Format);
+
+    Render::StateCache::Shared().BindTexture(textureId);
+
+    for (size_t i = 0; i < image.Levels.size(); ++i) {
+        const CompressedLevel &level = image.Levels[i];
+
+        glCompressedTexImage2D(
+            GL_TEXTURE_2D,
+            static_cast<GLint>(i),
+            internalFormat,
+            level.Width,
+            level.Height,
+            0,
+            static_cast<GLsizei>(level.Blocks.size()),
+            level.Blocks.data()
+        );
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(image.Levels.size()) - 1);
+    SetTextureParameters();
+}
+} // namespace Textures
+
+#endif
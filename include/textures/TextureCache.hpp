@@ -0,0 +1,214 @@
+/**
+ * @file Process-wide texture cache shared by every Model.
+ *
+ * Textures are keyed by their type and canonical path, hashed with FNV-1a, so the same file reached through different
+ * relative paths is only decoded and uploaded once. The type is part of the key because it picks the placeholder and
+ * the block format, so a file used both as a normal map and as a colour map gets a texture for each. Each acquisition
+ * takes a reference; released textures stay resident until `Evict` is called, so a model can be unloaded and reloaded
+ * without going back to disk. With content deduplication enabled, files whose bytes hash the same share one GL texture
+ * even when their names differ.
+ */
+
+#ifndef TEXTURES_TEXTURE_CACHE_H
+#define TEXTURES_TEXTURE_CACHE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cache/ModelCache.hpp"
+#include "render/StateCache.hpp"
+#include "textures/AsyncTextureLoader.hpp"
+#include "textures/Image.hpp"
+#include "textures/MipChain.hpp"
+#include "textures/TextureBake.hpp"
+#include "textures/TextureLoading.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Textures {
+class TextureCache {
+private:
+    struct PathHash {
+        size_t operator()(const std::string &path) const {
+            return static_cast<size_t>(
+                Cache::HashBytes(reinterpret_cast<const unsigned char *>(path.data()), path.size())
+            );
+        }
+    };
+
+    struct CachedTexture {
+        size_t References = 0;
+        uint64_t ContentHash = 0;
+        // `_byPath` keys of every path that resolved to this texture
+        std::vector<std::string> Keys;
+        // The loader still filling the texture in, if it was requested asynchronously
+        const AsyncTextureLoader *Loader = nullptr;
+    };
+
+    std::unordered_map<std::string, GLuint, PathHash> _byPath;
+    std::unordered_map<uint64_t, GLuint> _byContent;
+    std::unordered_map<GLuint, CachedTexture> _textures;
+
+    bool _deduplicateContent = false;
+    TextureSettings _settings;
+
+    size_t _hits = 0;
+    size_t _contentHits = 0;
+    size_t _misses = 0;
+
+    static std::string pathKey(const std::string &canonicalPath, const std::string &type) {
+        return type + '\n' + canonicalPath;
+    }
+
+    GLuint Share(GLuint textureId) {
+        ++_textures[textureId].References;
+        return textureId;
+    }
+
+public:
+    /**
+     * The cache used by all models. It never touches GL on destruction, since the context is usually gone by then;
+     * call `Evict` while the context is still current to free textures.
+     */
+    static TextureCache &Shared() {
+        static TextureCache cache;
+        return cache;
+    }
+
+    static std::string CanonicalPath(const std::string &path) {
+        std::error_code error;
+        std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+
+        if (error) {
+            canonical = std::filesystem::path(path).lexically_normal();
+        }
+
+        return canonical.generic_string();
+    }
+
+    void SetContentDeduplication(bool enabled) { _deduplicateContent = enabled; }
+
+    /**
+     * Loads textures through the BC1/BC3/BC5 bake cache when the driver supports it. Must run on the GL thread.
+     */
+    void SetBlockCompression(bool enabled) { _settings.BlockCompression = enabled && SupportsBlockCompression(); }
+
+    /**
+     * Builds mip chains on the CPU with `options` rather than with `glGenerateMipmap`. The options also apply to the
+     * levels baked for block compression.
+     */
+    void SetCpuMipmaps(bool enabled, const MipOptions &options = MipOptions()) {
+        _settings.CpuMipmaps = enabled;
+        _settings.Mips = options;
+    }
+
+    /**
+     * Returns the texture for `path` used as `type`, loading it on a miss. Loads go through `loader` when given, so the
+     * texture may still be a placeholder when this returns. Every call must be paired with a `Release`.
+     */
+    GLuint Acquire(const std::string &path, const std::string &type, AsyncTextureLoader *loader = nullptr) {
+        const std::string canonicalPath = CanonicalPath(path);
+        const std::string key = pathKey(canonicalPath, type);
+
+        auto byPath = _byPath.find(key);
+
+        if (byPath != _byPath.end()) {
+            ++_hits;
+            return Share(byPath->second);
+        }
+
+        uint64_t contentHash = 0;
+
+        if (_deduplicateContent) {
+            contentHash = Cache::HashFile(canonicalPath);
+            contentHash = contentHash ? Cache::HashString(type, contentHash) : 0;
+            auto byContent = contentHash ? _byContent.find(contentHash) : _byContent.end();
+
+            if (byContent != _byContent.end()) {
+                ++_contentHits;
+                _byPath.emplace(key, byContent->second);
+                _textures[byContent->second].Keys.push_back(key);
+                return Share(byContent->second);
+            }
+        }
+
+        ++_misses;
+
+        const GLuint textureId =
+            loader ? loader->Request(canonicalPath, type, _settings) : LoadTexture(canonicalPath, type, _settings);
+
+        CachedTexture &texture = _textures[textureId];
+        texture.ContentHash = contentHash;
+        texture.Loader = loader;
+        texture.Keys.push_back(key);
+
+        _byPath.emplace(key, textureId);
+
+        if (contentHash) {
+            _byContent.emplace(contentHash, textureId);
+        }
+
+        return Share(textureId);
+    }
+
+    void Release(GLuint textureId) {
+        auto texture = _textures.find(textureId);
+
+        if (texture != _textures.end() && texture->second.References > 0) {
+            --texture->second.References;
+        }
+    }
+
+    /**
+     * Deletes every texture nobody holds a reference to, except those whose upload is still queued on their loader;
+     * a later `Evict` picks them up. Must run on the GL thread, while those loaders are alive. Returns the number
+     * deleted.
+     */
+    size_t Evict() {
+        std::vector<GLuint> unused;
+
+        for (auto texture = _textures.begin(); texture != _textures.end();) {
+            const CachedTexture &cached = texture->second;
+
+            if (cached.References > 0 || (cached.Loader && cached.Loader->IsPending(texture->first))) {
+                ++texture;
+                continue;
+            }
+
+            for (const std::string &key : texture->second.Keys) {
+                _byPath.erase(key);
+            }
+
+            if (texture->second.ContentHash) {
+                _byContent.erase(texture->second.ContentHash);
+            }
+
+            unused.push_back(texture->first);
+            texture = _textures.erase(texture);
+        }
+
+        for (GLuint textureId : unused) {
+            Render::StateCache::Shared().ForgetTexture(textureId);
+        }
+
+        if (!unused.empty()) {
+            glDeleteTextures(static_cast<GLsizei>(unused.size()), unused.data());
+        }
+
+        return unused.size();
+    }
+
+    size_t Size() const { return _textures.size(); }
+
+    size_t Hits() const { return _hits; }
+
+    size_t ContentHits() const { return _contentHits; }
+
+    size_t Misses() const { return _misses; }
+};
+} // namespace Textures
+
+#endif
@@ -0,0 +1,153 @@
+/**
+ * @file Turns a texture file into GL texture data, split into a thread-safe preparation step and a GL upload step.
+ *
+ * Preparation decodes the image, or reads and if needed bakes its block-compressed form, and builds CPU mip levels
+ * when asked to. Only the upload touches the GL context, so the synchronous loader and `AsyncTextureLoader` share the
+ * same code and differ only in which thread prepares.
+ */
+
+#ifndef TEXTURES_TEXTURE_LOADING_H
+#define TEXTURES_TEXTURE_LOADING_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "render/StateCache.hpp"
+#include "textures/Image.hpp"
+#include "textures/MipChain.hpp"
+#include "textures/TextureBake.hpp"
+
+#include "openGLCommon.hpp"
+
+namespace Textures {
+struct TextureSettings {
+    // Go through the BC1/BC3/BC5 bake cache instead of uploading uncompressed texels
+    bool BlockCompression = false;
+    // Build uncompressed mip levels with `Mips` instead of `glGenerateMipmap`; baked textures always do
+    bool CpuMipmaps = false;
+    MipOptions Mips;
+};
+
+struct PreparedTexture {
+    std::string Path;
+    Image Pixels;
+    // Levels below `Pixels`, empty when the driver builds them
+    std::vector<MipLevel> Mips;
+    CompressedImage Compressed;
+};
+
+/**
+ * Only diffuse maps hold sRGB colour; specular, normal and other data maps are filtered as stored.
+ */
+inline MipOptions MipOptionsFor(const std::string &type, MipOptions options) {
+    options.SRGB = options.SRGB && type == "texture_diffuse";
+    return options;
+}
+
+/**
+ * Does all the CPU work for a texture. Safe to call from any thread.
+ */
+inline PreparedTexture
+PrepareTexture(const std::string &path, const std::string &type, const TextureSettings &settings) {
+    PreparedTexture texture;
+    texture.Path = path;
+
+    const MipOptions mips = MipOptionsFor(type, settings.Mips);
+
+    if (settings.BlockCompression) {
+        texture.Compressed = LoadOrBakeTexture(path, type, mips);
+
+        if (!texture.Compressed.Levels.empty()) {
+            return texture;
+        }
+    }
+
+    texture.Pixels = DecodeImage(path);
+
+    if (texture.Pixels.Data && settings.CpuMipmaps) {
+        texture.Mips = BuildMipLevels(
+            texture.Pixels.Data.get(), texture.Pixels.Width, texture.Pixels.Height, texture.Pixels.Components, mips
+        );
+    }
+
+    return texture;
+}
+
+/**
+ * Uploads a prepared texture into `textureId`. Must run on the GL thread. Returns false if preparation failed, in
+ * which case the texture is left as it was.
+ */
+inline bool UploadPreparedTexture(GLuint textureId, const PreparedTexture &texture) {
+    if (!texture.Compressed.Levels.empty()) {
+        UploadCompressedImage(textureId, texture.Compressed);
+        return true;
+    }
+
+    if (!texture.Pixels.Data) {
+        std::cout << "Failed to load texture\npath: " << texture.Path << std::endl;
+        return false;
+    }
+
+    if (texture.Mips.empty()) {
+        UploadImage(textureId, texture.Pixels);
+        return true;
+    }
+
+    const GLenum format = FormatFor(texture.Pixels.Components);
+
+    Render::StateCache::Shared().BindTexture(textureId);
+
+    // Small levels of one and three channel images have rows that are not 4-byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(
+        GL_TEXTURE_2D,
+        0,
+        format,
+        texture.Pixels.Width,
+        texture.Pixels.Height,
+        0,
+        format,
+        GL_UNSIGNED_BYTE,
+        texture.Pixels.Data.get()
+    );
+
+    for (size_t i = 0; i < texture.Mips.size(); ++i) {
+        const MipLevel &level = texture.Mips[i];
+        glTexImage2D(
+            GL_TEXTURE_2D,
+            static_cast<GLint>(i + 1),
+            format,
+            level.Width,
+            level.Height,
+            0,
+            format,
+            GL_UNSIGNED_BYTE,
+            level.Pixels.data()
+        );
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(texture.Mips.size()));
+    SetTextureParameters();
+
+    return true;
+}
+
+/**
+ * Prepares and uploads a texture on the calling thread, which must own the GL context.
+ */
+inline GLuint
+LoadTexture(const std::string &path, const std::string &type, const TextureSettings &settings = TextureSettings()) {
+    GLuint textureId;
+    glGenTextures(1, &textureId);
+
+    UploadPreparedTexture(textureId, PrepareTexture(path, type, settings));
+
+    return textureId;
+}
+} // namespace Textures
+
+#endif
@@ -0,0 +1,166 @@
+/**
+ * @file A fixed-size pool of worker threads for CPU-side loading work
+ */
+
+#ifndef THREADING_THREAD_POOL_H
+#define THREADING_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Threading {
+class ThreadPool {
+private:
+    std::vector<std::thread> _workers;
+    std::queue<std::function<void()>> _tasks;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    bool _stopping = false;
+
+    struct ParallelForState {
+        std::function<void(size_t)> body;
+        size_t count;
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::exception_ptr error;
+    };
+
+    static void RunParallelFor(const std::shared_ptr<ParallelForState> &state) {
+        size_t completed = 0;
+
+        for (size_t i = state->next++; i < state->count; i = state->next++) {
+            try {
+                state->body(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (!state->error) {
+                    state->error = std::current_exception();
+                }
+            }
+            ++completed;
+        }
+
+        if (completed && state->done.fetch_add(completed) + completed == state->count) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->finished.notify_all();
+        }
+    }
+
+    void WorkerLoop() {
+        for (;;) {
+            std::function<void()> task;
+
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _condition.wait(lock, [this] { return _stopping || !_tasks.empty(); });
+
+                if (_stopping && _tasks.empty()) {
+                    return;
+                }
+
+                task = std::move(_tasks.front());
+                _tasks.pop();
+            }
+
+            task();
+        }
+    }
+
+    void Enqueue(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _tasks.push(std::move(task));
+        }
+        _condition.notify_one();
+    }
+
+public:
+    static size_t DefaultThreadCount() { return std::max(2u, std::thread::hardware_concurrency()); }
+
+    explicit ThreadPool(size_t threadCount = DefaultThreadCount()) {
+        _workers.reserve(threadCount);
+
+        for (size_t i = 0; i < threadCount; ++i) {
+            _workers.emplace_back([this] { WorkerLoop(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _condition.notify_all();
+
+        for (std::thread &worker : _workers) {
+            worker.join();
+        }
+    }
+
+    /**
+     * The pool shared by all loaders, created on first use.
+     */
+    static ThreadPool &Shared() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    size_t ThreadCount() const { return _workers.size(); }
+
+    template <typename F> std::future<std::invoke_result_t<F>> Submit(F &&function) {
+        using Result = std::invoke_result_t<F>;
+
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+        std::future<Result> result = task->get_future();
+        Enqueue([task] { (*task)(); });
+
+        return result;
+    }
+
+    /**
+     * Calls `body(i)` for every i in [0, count) across the pool and returns once all calls have finished. The calling
+     * thread takes part in the work, so this is safe to call from inside another pool task.
+     */
+    void ParallelFor(size_t count, std::function<void(size_t)> body) {
+        if (count == 0) {
+            return;
+        }
+
+        auto state = std::make_shared<ParallelForState>();
+        state->body = std::move(body);
+        state->count = count;
+
+        const size_t helpers = std::min(count - 1, _workers.size());
+
+        for (size_t i = 0; i < helpers; ++i) {
+            Enqueue([state] { RunParallelFor(state); });
+        }
+
+        RunParallelFor(state);
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&state] { return state->done.load() == state->count; });
+
+        if (state->error) {
+            std::rethrow_exception(state->error);
+        }
+    }
+};
+} // namespace Threading
+
+#endif
@@ -8,7 +8,7 @@ struct Vertex {
     glm::vec3 Normal;
     glm::vec2 TextureCoordinates;
     glm::vec3 Tangent;
-    glm::vec2 BitTangent;
+    glm::vec3 BitTangent;
 
     Vertex(
         glm::vec3 position,
@@ -1,16 +1,28 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <iostream>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "buffers/FrameRingBuffer.hpp"
+#include "buffers/UniformBlocks.hpp"
+#include "cache/ProgramCache.hpp"
 #include "camera/Camera.hpp"
 #include "camera/FlyingCamera.hpp"
 #include "model.hpp"
+#include "render/MultiDrawBatch.hpp"
+#include "render/RenderQueue.hpp"
+#include "render/StateCache.hpp"
 #include "shader.hpp"
+#include "shading/ShaderFeatures.hpp"
+#include "shading/ShaderVariants.hpp"
 
 #include "colors/Color.hpp"
 #include "lights/Attenuation.hpp"
@@ -20,7 +32,14 @@
 
 #include "models/Box.hpp"
 
+#include "textures/AsyncTextureLoader.hpp"
+#include "textures/MipChain.hpp"
+#include "textures/TextureCache.hpp"
+
+#include "threading/ThreadPool.hpp"
+
 #include "openGLCommon.hpp"
+#include "openGLExtensions.hpp"
 
 float deltaTime = 0.0f;
 float lastFrameTime = 0.0f;
@@ -28,6 +47,11 @@ float lastFrameTime = 0.0f;
 constexpr unsigned int SCR_WIDTH = 800;
 constexpr unsigned int SCR_HEIGHT = 600;
 
+constexpr float TEXTURE_UPLOAD_BUDGET_MS = 4.0f;
+
+constexpr float NEAR_PLANE = 0.1f;
+constexpr float FAR_PLANE = 100.0f;
+
 float lastX = 400, lastY = 300;
 
 std::unique_ptr<Camera> camera =
@@ -75,11 +99,68 @@ void framebufferSizeCallback(__attribute__((unused)) GLFWwindow *window, int wid
     glViewport(0, 0, width, height);
 }
 
+void reportFirstFrame(
+    std::chrono::steady_clock::time_point startTime,
+    bool programCache,
+    const Shading::ShaderVariants &objectShaders,
+    const Render::RenderQueue &queue,
+    const Render::MultiDrawBatch &batch,
+    const Buffers::FrameRingBuffer &ring
+) {
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    const Cache::ProgramCacheStatistics &programs = Cache::ProgramCacheCounters();
+
+    std::cout << "Time to first frame: " << elapsed.count() << " ms\nProgram cache: ";
+
+    if (programCache && Extensions::ProgramBinarySupported) {
+        std::cout << programs.Hits << " hits, " << programs.Misses << " misses, " << programs.Rejected << " rejected";
+    } else {
+        std::cout << (programCache ? "unsupported" : "disabled");
+    }
+
+    const ShaderBuildStatistics &builds = ShaderBuildCounters();
+
+    std::cout << "\nShader builds: " << builds.Compiled << " compiled, ";
+
+    if (Extensions::ParallelShaderCompileSupported) {
+        std::cout << builds.ReadyWhenUsed << " ready when first used, ";
+    } else {
+        std::cout << "parallel compilation unsupported, ";
+    }
+
+    std::cout << builds.WaitMilliseconds << " ms waiting\nShader permutations: " << objectShaders.Count() << std::endl;
+
+    const Render::StateStatistics &state = Render::StateCache::Shared().Statistics();
+    std::cout << "GL state changes: " << state.Issued << " issued, " << state.Skipped << " skipped" << std::endl;
+
+    const Render::QueueStatistics &draws = queue.Statistics();
+    std::cout << "Render queue: " << draws.Packets << " packets, " << draws.ProgramChanges << " program changes, "
+              << draws.MaterialChanges << " material changes" << std::endl;
+
+    const Render::BatchStatistics &batches = batch.Statistics();
+    std::cout << "Multi-draw: " << batches.Draws << " mesh draws as " << batches.Commands << " commands in "
+              << batches.Batches << (Extensions::MultiDrawIndirectSupported ? " calls" : " batches, unsupported")
+              << std::endl;
+
+    const Buffers::RingStatistics &frames = ring.Statistics();
+    std::cout << "Frame ring buffer: " << (ring.IsPersistent() ? "persistent, " : "buffer storage unsupported, ")
+              << frames.PeakBytes << " bytes used, " << frames.Waits << " waits, " << frames.Overflows << " overflows"
+              << std::endl;
+}
+
 struct GLFWDeleter {
     void operator()(__attribute__((unused)) GLFWwindow *window) { glfwTerminate(); }
 };
 
-int main() {
+int main(int argc, char **argv) {
+    const auto startTime = std::chrono::steady_clock::now();
+
+    // Compile every program from source, to compare startup with and without stored binaries
+    ShaderOptions shaderOptions;
+    shaderOptions.UseProgramCache = !(argc > 1 && std::string(argv[1]) == "--no-program-cache");
+    // Programs build on driver threads during the model import and are waited on when first drawn with
+    shaderOptions.Async = true;
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -102,6 +183,8 @@ int main() {
         return -1;
     }
 
+    Extensions::Load();
+
     glEnable(GL_DEPTH_TEST);
     glfwSetInputMode(window.get(), GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetCursorPosCallback(window.get(), mouseCallback);
@@ -136,20 +219,69 @@ int main() {
         pointLights.push_back(Light::PointLight(def.second, Light::BasicAttenuation, def.first));
     }
 
-    Shader basicObjectShader(
+    // Each mesh is drawn with the permutation its textures need, compiled the first time it is seen
+    Shading::ShaderVariants objectShaders(
         shaderFolder + "vertex/modelViewProjectionWithNormalAndTex.vert",
-        shaderFolder + "fragment/litMaterialTextureMap.frag"
+        shaderFolder + "fragment/litMaterialTextureMap.frag",
+        shaderOptions
     );
 
-    basicObjectShader.use();
-    basicObjectShader.setDirectionalLight(directionalLight);
-    basicObjectShader.setInt("numPointLights", pointLights.size());
+    // The light count is fixed for the whole run, so the light loop is unrolled in every permutation
+    const uint32_t sceneFeatures = Shading::PointLightFeature(std::min(pointLights.size(), Buffers::MAX_POINT_LIGHTS));
+    objectShaders.PrepareMaterials(sceneFeatures | Shading::FEATURE_MULTI_DRAW);
 
-    Shader lightShader(shaderFolder + "vertex/modelViewProjection.vert", shaderFolder + "fragment/light.frag");
+    Shader lightShader(
+        shaderFolder + "vertex/instancedModelViewProjection.vert",
+        shaderFolder + "fragment/instanceColor.frag",
+        shaderOptions
+    );
 
-    Model::Model backpack((modelFolder + "backpack/backpack.obj").c_str());
+    // Camera and lights for every program, uploaded once per frame
+    Buffers::FrameUniforms frameUniforms;
+    frameUniforms.Lights.DirectionalLight = Buffers::Std140DirectionalLight(directionalLight);
+    frameUniforms.Lights.SetPointLights(pointLights);
+
+    Textures::MipOptions mipOptions;
+    mipOptions.Filter = Textures::MipFilter::Kaiser;
+    mipOptions.SRGB = true;
+    mipOptions.Pool = &Threading::ThreadPool::Shared();
+
+    Textures::TextureCache::Shared().SetBlockCompression(true);
+    Textures::TextureCache::Shared().SetCpuMipmaps(true, mipOptions);
+    Textures::AsyncTextureLoader textureLoader;
+
+    Model::LoadOptions loadOptions;
+    loadOptions.TextureLoader = &textureLoader;
+    loadOptions.WeldVertices = true;
+    loadOptions.OptimizeVertexCache = true;
+    loadOptions.GenerateLods = true;
+    loadOptions.BuildMeshlets = true;
+    loadOptions.PackVertices = true;
+    loadOptions.SplitLargeMeshes = true;
+    loadOptions.Retention = CpuRetention::Drop;
+
+    Model::Model backpack((modelFolder + "backpack/backpack.obj").c_str(), loadOptions);
     Box::Init();
 
+    // The lights never move, so their boxes are laid out once and drawn as one instanced batch every frame
+    std::vector<glm::mat4> lightTransforms;
+    std::vector<glm::vec3> lightColors;
+
+    for (const Light::PointLight &light : pointLights) {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, light.position);
+        model = glm::scale(model, glm::vec3(0.2f));
+
+        lightTransforms.push_back(model);
+        lightColors.push_back(light.color.specular);
+    }
+
+    Render::RenderQueue queue;
+    Render::MultiDrawBatch batch;
+    // Camera and lights, light box instances and indirect commands are written here each frame
+    Buffers::FrameRingBuffer ring;
+    bool firstFrameReported = false;
+
     while (!glfwWindowShouldClose(window.get())) {
         const float currentTime = glfwGetTime();
         deltaTime = currentTime - lastFrameTime;
@@ -157,54 +289,54 @@ int main() {
 
         processInput(window.get());
 
+        // Counted per frame, so the first frame report shows what one frame costs
+        Render::StateCache::Shared().ResetStatistics();
+        ring.Begin();
+
+        textureLoader.ProcessUploads(TEXTURE_UPLOAD_BUDGET_MS);
+
         // Render
         glClearColor(0.1f, 0.1f, 0.1f, 0.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glm::mat4 projection = glm::perspective(camera->Zoom(), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        glm::mat4 projection =
+            glm::perspective(camera->Zoom(), (float)SCR_WIDTH / (float)SCR_HEIGHT, NEAR_PLANE, FAR_PLANE);
         glm::mat4 view = camera->GetViewMatrix();
 
-        lightShader.use();
-
-        for (const auto &light : pointLights) {
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, light.position);
-            model = glm::scale(model, glm::vec3(0.2f));
+        spotLight.position = camera->Position();
+        spotLight.direction = camera->Front();
 
-            lightShader.setVec3("lightColor", light.color.specular);
+        frameUniforms.Camera.View = view;
+        frameUniforms.Camera.Projection = projection;
+        frameUniforms.Camera.ViewPosition = glm::vec4(camera->Position(), 1.0f);
+        frameUniforms.Lights.SpotLight = Buffers::Std140SpotLight(spotLight);
+        frameUniforms.Upload(ring);
 
-            Box::Draw(lightShader, model, view, projection);
-        }
+        // Drawn in key order rather than submission order
+        queue.Begin(view, FAR_PLANE);
 
-        spotLight.position = camera->Position();
-        spotLight.direction = camera->Front();
+        Box::Submit(queue, ring, lightShader, lightTransforms.data(), lightColors.data(), lightTransforms.size());
 
         glm::mat4 backpackModel = glm::mat4(1.0f);
         backpackModel = glm::translate(backpackModel, glm::vec3(0.0f, 0.0f, 0.0f));
         backpackModel = glm::scale(backpackModel, glm::vec3(1.0f, 1.0f, 1.0f));
 
-        glm::mat3 rotation = glm::transpose(glm::inverse(glm::mat3(backpackModel)));
-
-        basicObjectShader.use();
-        basicObjectShader.setMat4("model", backpackModel);
-        basicObjectShader.setMat4("view", view);
-        basicObjectShader.setMat4("projection", projection);
-        basicObjectShader.setMat3("rotation", rotation);
-        basicObjectShader.setSpotLight(spotLight);
-
-        for (size_t i = 0; i < pointLights.size(); ++i) {
-            basicObjectShader.setPointLight(pointLights[i], i);
-        }
-
-        basicObjectShader.setVec3("viewPosition", camera->Position());
-
-        backpack.Draw(basicObjectShader);
+        // Every backpack mesh sharing a permutation and material goes out in one multi-draw call
+        batch.Begin();
+        backpack.Submit(batch, objectShaders, sceneFeatures, *camera, projection, backpackModel, SCR_HEIGHT);
+        batch.Flush(queue, &ring);
 
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        ring.Commit();
+        queue.Execute();
+        ring.End();
 
         glfwSwapBuffers(window.get());
         glfwPollEvents();
+
+        if (!firstFrameReported) {
+            reportFirstFrame(startTime, shaderOptions.UseProgramCache, objectShaders, queue, batch, ring);
+            firstFrameReported = true;
+        }
     }
 
     return 0;
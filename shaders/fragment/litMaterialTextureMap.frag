@@ -11,55 +11,21 @@ struct Material {
     float shininess;
 };
 
-struct Color {
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct Attenuation {
-    float constant;
-    float linear;
-    float quadratic;
-};
-
-struct DirectionalLight {
-    Color color;
-    vec3 direction;
-};
-
-struct PointLight {
-    Color color;
-    Attenuation attenuation;
-    vec3 position;
-};
-
-struct SpotLight {
-    Color color;
-    Attenuation attenuation;
-    vec3 position;
-    vec3 direction;
-    float innerRadius;
-    float outerRadius;
-};
-
-#define MAX_NUM_POINT_LIGHTS 4
+#include "../include/camera.glsl"
+#include "../include/lights.glsl"
 
 out vec4 FragColor;
 
 uniform Material material;
-uniform DirectionalLight directionalLight;
-uniform PointLight pointLights[MAX_NUM_POINT_LIGHTS];
-uniform int numPointLights;
-uniform SpotLight spotLight;
-uniform vec3 viewPosition;
 
 uniform mat3 rotation;
 
 in vec3 FragPosition;
 in vec3 Normal;
 in vec2 TexCoords;
+#ifdef HAS_NORMAL_MAP
 in mat3 TBN;
+#endif
 
 vec3 unitNormal;
 vec3 sampledDiffuse;
@@ -75,6 +41,7 @@ vec3 getLight(Color color, vec3 direction) {
     float diff = max(dot(unitNormal, unitDirection), 0.0f);
     vec3 diffuse = color.diffuse * diff * sampledDiffuse;
 
+#ifdef HAS_SPECULAR_MAP
     // Specular lighting
     vec3 viewDirection = normalize(viewPosition - FragPosition);
     vec3 halfwayDirection = normalize(direction + viewDirection);
@@ -82,6 +49,9 @@ vec3 getLight(Color color, vec3 direction) {
     vec3 specular = color.specular * shine * sampledSpecular;
 
     return ambient + diffuse + specular;
+#else
+    return ambient + diffuse;
+#endif
 }
 
 float getAttenuation(Attenuation attenuation, float distance) {
@@ -122,18 +92,29 @@ vec3 getSpotLight(SpotLight light) {
 
 void main() {
     sampledDiffuse = texture(material.texture_diffuse0, TexCoords).rgb;
+#ifdef HAS_SPECULAR_MAP
     sampledSpecular = texture(material.texture_specular0, TexCoords).rgb;
-    vec3 normal = texture(material.texture_normal0, TexCoords).rgb;
-    normal = normal * 2.0 - 1.0;
-    normal = TBN * normal;
-    unitNormal = normalize(normal);
+#endif
+#ifdef HAS_NORMAL_MAP
+    // Only x and y are read so two-channel (BC5) normal maps work; z is rebuilt from the unit length
+    vec2 normalXY = texture(material.texture_normal0, TexCoords).rg * 2.0 - 1.0;
+    vec3 normal = vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0)));
+    unitNormal = normalize(TBN * normal);
+#else
+    unitNormal = normalize(Normal);
+#endif
 
     vec3 result = vec3(0.0);
 
     result += getDirectionalLight(directionalLight);
     result += getSpotLight(spotLight);
 
+#ifdef POINT_LIGHT_COUNT
+    // A constant bound lets the compiler unroll the loop, or drop it for unlit permutations
+    for (int i = 0; i < POINT_LIGHT_COUNT; ++i) {
+#else
     for (int i = 0; i < numPointLights; ++i) {
+#endif
         result += getPointLight(pointLights[i]);
     }
 
@@ -0,0 +1,6 @@
+// Per-frame camera, shared by every program; see include/buffers/UniformBlocks.hpp
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+};
@@ -0,0 +1,43 @@
+// Light set shared by every program; see include/buffers/UniformBlocks.hpp
+
+struct Color {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct Attenuation {
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct DirectionalLight {
+    Color color;
+    vec3 direction;
+};
+
+struct PointLight {
+    Color color;
+    Attenuation attenuation;
+    vec3 position;
+};
+
+struct SpotLight {
+    Color color;
+    Attenuation attenuation;
+    vec3 position;
+    vec3 direction;
+    float innerRadius;
+    float outerRadius;
+};
+
+// Capacity of the block; a permutation's POINT_LIGHT_COUNT says how many of them it reads
+#define MAX_NUM_POINT_LIGHTS 4
+
+layout(std140) uniform Lights {
+    DirectionalLight directionalLight;
+    SpotLight spotLight;
+    PointLight pointLights[MAX_NUM_POINT_LIGHTS];
+    int numPointLights;
+};
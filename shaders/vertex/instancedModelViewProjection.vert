@@ -0,0 +1,15 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+// Per instance, streamed by Box; a mat4 attribute takes one location per column
+layout(location = 3) in mat4 instanceModel;
+layout(location = 7) in vec3 instanceColor;
+
+#include "../include/camera.glsl"
+
+out vec3 Color;
+
+void main()
+{
+    Color = instanceColor;
+    gl_Position = projection * view * instanceModel * vec4(aPos, 1.0f);
+}
@@ -5,25 +5,83 @@ layout(location = 2) in vec2 aTexCoords;
 layout(location = 3) in vec3 aTangent;
 layout(location = 4) in vec3 aBitTangent;
 
+// Packed layout, see include/packedVertex.hpp
+layout(location = 5) in vec4 aPackedPosition;
+layout(location = 6) in vec2 aPackedNormal;
+layout(location = 7) in vec2 aPackedTangent;
+
+#include "../include/camera.glsl"
+
+#ifdef MULTI_DRAW
+// Per-draw data, see include/render/MultiDrawBatch.hpp. The draw index advances once per command through its base
+// instance, and picks the draw's texels from the buffer texture.
+layout(location = 8) in uint aDrawIndex;
+
+#define DRAW_DATA_TEXELS 9
+uniform samplerBuffer drawData;
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 uniform mat3 rotation;
 
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+#endif
+
+uniform bool packedVertices;
+
 out vec3 FragPosition;
 out vec3 Normal;
 out vec2 TexCoords;
+#ifdef HAS_NORMAL_MAP
 out mat3 TBN;
+#endif
+
+vec3 octahedralDecode(vec2 encoded) {
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -fold : fold;
+    n.y += n.y >= 0.0 ? -fold : fold;
+    return normalize(n);
+}
 
 void main() {
-    FragPosition = vec3(model * vec4(aPos, 1.0));
-    Normal = rotation * aNormal;
+#ifdef MULTI_DRAW
+    int texel = int(aDrawIndex) * DRAW_DATA_TEXELS;
+    mat4 model = mat4(
+        texelFetch(drawData, texel),
+        texelFetch(drawData, texel + 1),
+        texelFetch(drawData, texel + 2),
+        texelFetch(drawData, texel + 3)
+    );
+    mat3 rotation = mat3(
+        texelFetch(drawData, texel + 4).xyz, texelFetch(drawData, texel + 5).xyz, texelFetch(drawData, texel + 6).xyz
+    );
+    vec3 positionOffset = texelFetch(drawData, texel + 7).xyz;
+    vec3 positionScale = texelFetch(drawData, texel + 8).xyz;
+#endif
+
+    vec3 position = aPos;
+    vec3 normal = aNormal;
+    vec3 tangent = aTangent;
+    vec3 bitTangent = aBitTangent;
+
+    if (packedVertices) {
+        position = positionOffset + aPackedPosition.xyz * positionScale;
+        normal = octahedralDecode(aPackedNormal);
+        tangent = octahedralDecode(aPackedTangent);
+        bitTangent = cross(normal, tangent) * (aPackedPosition.w * 2.0 - 1.0);
+    }
+
+    FragPosition = vec3(model * vec4(position, 1.0));
+    Normal = rotation * normal;
     TexCoords = aTexCoords;
 
-    vec3 T = normalize(vec3(model * vec4(aTangent, 0.0)));
-    vec3 B = normalize(vec3(model * vec4(aBitTangent, 0.0)));
-    vec3 N = normalize(vec3(model * vec4(aNormal, 0.0)));
+#ifdef HAS_NORMAL_MAP
+    vec3 T = normalize(vec3(model * vec4(tangent, 0.0)));
+    vec3 B = normalize(vec3(model * vec4(bitTangent, 0.0)));
+    vec3 N = normalize(vec3(model * vec4(normal, 0.0)));
     TBN = mat3(T, B, N);
+#endif
 
     gl_Position = projection * view * vec4(FragPosition, 1.0f);
 }